@@ -0,0 +1,504 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <malloc.h>
+#include "main.h"
+#include "spot_store.h"
+#include "spot_journal.h"
+#include "label_layout.h"
+#include "spot_time.h"
+#include "sources/hamqth.h"
+#include "sources/pota.h"
+#include "sources/sota.h"
+#include "sources/wwff.h"
+#include "synthetic.h"
+
+/**********************************************
+ * Headless benchmarks of the hot paths: merging spots into the store,
+ * restoring it from the journal, laying out labels, decoding each
+ * source's responses and parsing spot times. Everything runs on
+ * synthetic spots at 1k, 10k and 100k.
+ *
+ * Results go to stdout as JSON, one entry per benchmark and size:
+ * {"name": ..., "n": ..., "unit": ..., "iterations": ...,
+ *  "ns_per_op": ..., "ops_per_sec": ...}
+ * where an op is one unit (a spot, a row, a call). Memory use at 50k
+ * spots is reported the same way, with bytes per spot in place of
+ * timings.
+ *
+ * usage: spots_bench [name filter] [--min-time seconds]
+ **********************************************/
+
+// the store only ever compares source pointers
+struct SpotSource {};
+
+typedef std::chrono::steady_clock Clock;
+
+static double since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// keeps results alive so the work isn't optimized away
+static volatile size_t sink;
+
+/**********************************************
+ * Runner
+ **********************************************/
+
+class Bench {
+public:
+    // runs one iteration, returns the seconds spent on the part being
+    // measured so setup can be left out
+    typedef std::function<double()> Iteration;
+
+    Bench(const char* filter, double minTime) : filter(filter), minTime(minTime) {}
+
+    // ops is how many units one iteration processes
+    // returns false if the benchmark was filtered out
+    bool run(const std::string& name, size_t n, const char* unit, size_t ops, Iteration iteration) {
+        if (filter && name.find(filter) == name.npos) { return false; }
+
+        // repeat until there's enough measured time to be stable, but
+        // don't let setup heavy benchmarks run forever
+        double measured = 0;
+        size_t iterations = 0;
+        Clock::time_point start = Clock::now();
+        while (iterations < 3 || measured < minTime) {
+            measured += iteration();
+            iterations++;
+            if (since(start) > 10 * minTime) { break; }
+        }
+
+        double nsPerOp = measured * 1e9 / ((double)iterations * ops);
+        printf("%s\n    {\"name\": \"%s\", \"n\": %zu, \"unit\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f}",
+                results ? "," : "", name.c_str(), n, unit, iterations, nsPerOp, 1e9 / nsPerOp);
+        fflush(stdout);
+        results++;
+        return true;
+    }
+
+    // a result that isn't timed, values per unit
+    bool report(const std::string& name, size_t n, const char* unit, const std::vector<std::pair<const char*, double>>& values) {
+        if (filter && name.find(filter) == name.npos) { return false; }
+        printf("%s\n    {\"name\": \"%s\", \"n\": %zu, \"unit\": \"%s\"", results ? "," : "", name.c_str(), n, unit);
+        for (const auto& value : values) {
+            printf(", \"%s\": %.1f", value.first, value.second);
+        }
+        printf("}");
+        fflush(stdout);
+        results++;
+        return true;
+    }
+
+private:
+    const char* filter;
+    double minTime;
+    size_t results = 0;
+};
+
+/**********************************************
+ * Benchmarks
+ **********************************************/
+
+static SpotSource source;
+static SpotSource other;
+
+// how providers hand spots over, in poll sized batches
+static std::vector<std::vector<Spot>> batches(const std::vector<Spot>& spots, size_t size = 200) {
+    std::vector<std::vector<Spot>> out;
+    for (size_t i = 0; i < spots.size(); i += size) {
+        out.emplace_back(spots.begin() + i, spots.begin() + std::min(i + size, spots.size()));
+    }
+    return out;
+}
+
+static void benchStore(Bench& bench, size_t n, SpotTime now) {
+    std::vector<Spot> spots = makeSpots(n, now);
+
+    bench.run("store_merge", n, "spot", n, [&]() {
+        SpotStore store;
+        auto input = batches(spots);
+        Clock::time_point start = Clock::now();
+        for (auto& batch : input) {
+            store.merge(std::move(batch), &source);
+        }
+        double t = since(start);
+        sink = store.size();
+        return t;
+    });
+
+    // what the merge thread does for every provider batch
+    bench.run("store_add_spots", n, "spot", n, [&]() {
+        SpotStore store;
+        auto input = batches(spots);
+        Clock::time_point start = Clock::now();
+        for (auto& batch : input) {
+            if (store.merge(std::move(batch), &source) > 0) {
+                store.publish();
+            }
+        }
+        double t = since(start);
+        sink = store.current()->spots.size();
+        return t;
+    });
+
+    // providers re-send what we already have every poll
+    SpotStore full;
+    full.merge(std::vector<Spot>(spots), &source);
+    bench.run("store_merge_unchanged", n, "spot", n, [&]() {
+        auto input = batches(spots);
+        Clock::time_point start = Clock::now();
+        size_t changed = 0;
+        for (auto& batch : input) {
+            changed += full.merge(std::move(batch), &source);
+        }
+        double t = since(start);
+        sink = changed;
+        return t;
+    });
+
+    // a second source carrying the same spots, like two clusters on one
+    // network, only adds itself and its spotters
+    bench.run("store_merge_second_source", n, "spot", n, [&]() {
+        SpotStore store;
+        store.merge(std::vector<Spot>(spots), &source);
+        auto input = batches(spots);
+        for (auto& batch : input) {
+            for (Spot& spot : batch) { spot.spotter += "/2"; }
+        }
+        Clock::time_point start = Clock::now();
+        size_t changed = 0;
+        for (auto& batch : input) {
+            changed += store.merge(std::move(batch), &other);
+        }
+        double t = since(start);
+        sink = changed;
+        return t;
+    });
+
+    bench.run("store_publish", n, "spot", n, [&]() {
+        Clock::time_point start = Clock::now();
+        full.publish();
+        return since(start);
+    });
+
+    // half the spots are older than two hours
+    bench.run("store_expire", n, "spot", n, [&]() {
+        SpotStore store;
+        store.merge(std::vector<Spot>(spots), &source);
+        Clock::time_point start = Clock::now();
+        sink = store.expire(now - std::chrono::hours(2));
+        return since(start);
+    });
+}
+
+// bytes in use from malloc, mmapped chunks included
+static size_t heapInUse() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// what the store holds per spot once the hub has merged and published
+// everything, by where it goes. heap is what malloc says the whole store
+// took, to check the estimates against
+static void benchMemory(Bench& bench, size_t n, SpotTime now) {
+    std::vector<Spot> spots = makeSpots(n, now);
+    size_t before = heapInUse();
+    SpotStore::Memory m;
+    size_t heap;
+    {
+        auto store = std::make_unique<SpotStore>();
+        auto input = batches(spots);
+        for (auto& batch : input) {
+            if (store->merge(std::move(batch), &source) > 0) {
+                store->publish();
+            }
+        }
+        input.clear();
+        input.shrink_to_fit();
+        m = store->memory();
+        heap = heapInUse() - before;
+        sink = store->size();
+    }
+    double count = n;
+    bench.report("store_memory", n, "spot", {
+        {"string_pages", m.stringPages / count},
+        {"string_blocks", m.stringBlocks / count},
+        {"string_index", m.stringIndex / count},
+        {"slots", m.slots / count},
+        {"key_index", m.keyIndex / count},
+        {"freq_index", m.freqIndex / count},
+        {"expiry_heap", m.expiryHeap / count},
+        {"snapshot", m.snapshot / count},
+        {"total", m.total() / count},
+        {"heap", heap / count}
+    });
+}
+
+// what a restart costs before any source has polled
+static void benchJournal(Bench& bench, size_t n, SpotTime now) {
+    char dir[] = "/tmp/spots_benchXXXXXX";
+    if (!mkdtemp(dir)) { return; }
+    std::string path = std::string(dir) + "/spots.journal";
+    auto restore = [&]() {
+        SpotStore store;
+        SpotJournal journal;
+        journal.addSource(&source, "bench");
+        Clock::time_point start = Clock::now();
+        journal.open(path);
+        sink = journal.replay(store, now - std::chrono::hours(4));
+        store.publish();
+        return since(start);
+    };
+
+    // every spot appended as it was merged
+    SpotStore store;
+    std::vector<SpotRecord> changed;
+    store.merge(makeSpots(n, now), &source, &changed);
+    SpotJournal journal;
+    journal.addSource(&source, "bench");
+    journal.open(path);
+    journal.append(changed, store);
+    journal.close();
+    bench.run("journal_restore", n, "spot", n, restore);
+
+    // what a restart usually finds, a snapshot
+    journal.open(path);
+    journal.replay(store, now - std::chrono::hours(4));
+    journal.compact(store);
+    journal.close();
+    bench.run("journal_restore_snapshot", n, "spot", n, restore);
+
+    unlink(path.c_str());
+    rmdir(dir);
+}
+
+// roughly ImGui's default font, the layout doesn't care how it's measured
+static float fixedTextWidth(std::string_view label, void*) {
+    return 7.0f * label.size();
+}
+
+static void benchLayout(Bench& bench, size_t n, SpotTime now) {
+    SpotStore store;
+    store.merge(makeSpots(n, now), &source);
+    store.publish();
+    auto first = store.current();
+    store.publish();
+    auto second = store.current();
+
+    // 40m on a 1920 pixel wide waterfall, showing the last four hours
+    LabelLayout::View view = {7000e3, 7200e3, 1920 / 200e3, 1920};
+    SpotTime displayTime = now - std::chrono::hours(4);
+
+    // everything from scratch, text widths included
+    bench.run("layout_full", n, "call", 1, [&]() {
+        LabelLayout layout(&fixedTextWidth, NULL);
+        Clock::time_point start = Clock::now();
+        layout.update(first, displayTime, view);
+        return since(start);
+    });
+
+    // a new snapshot, with the text widths already known
+    LabelLayout layout(&fixedTextWidth, NULL);
+    bool flip = false;
+    bench.run("layout_relayout", n, "call", 1, [&]() {
+        flip = !flip;
+        Clock::time_point start = Clock::now();
+        layout.update(flip ? second : first, displayTime, view);
+        return since(start);
+    });
+
+    // what most frames do: nothing changed, walk the visible labels
+    bench.run("layout_frame", n, "call", 1, [&]() {
+        Clock::time_point start = Clock::now();
+        layout.update(second, displayTime, view);
+        auto visible = layout.visible(view);
+        size_t count = 0;
+        for (auto it = visible.first; it != visible.second; ++it) {
+            count += it->lane;
+        }
+        double t = since(start);
+        sink = count;
+        return t;
+    });
+}
+
+static void countSpots(std::vector<Spot>&& spots, void*, void* ctx) {
+    *(size_t*)ctx += spots.size();
+}
+
+// decoding a whole response, fresh and then again the next poll when
+// every row has been seen before
+template <typename Provider>
+static void benchProvider(Bench& bench, const std::string& name, size_t n, const std::string& body) {
+    size_t decoded = 0;
+    bool ran = bench.run(name + "_decode", n, "row", n, [&]() {
+        Provider provider;
+        decoded = 0;
+        provider.registerAddSpots(&countSpots, NULL, &decoded);
+        Clock::time_point start = Clock::now();
+        provider.decode(body.data(), body.size());
+        return since(start);
+    });
+    if (ran && decoded != n) {
+        flog::error("{0} decoded {1} of {2} rows", name, decoded, n);
+    }
+
+    bench.run(name + "_repeat", n, "row", n, [&]() {
+        Provider provider;
+        provider.registerAddSpots(&countSpots, NULL, &decoded);
+        provider.decode(body.data(), body.size());
+        Clock::time_point start = Clock::now();
+        provider.decode(body.data(), body.size());
+        return since(start);
+    });
+}
+
+static void benchParsers(Bench& bench, size_t n, SpotTime now) {
+    std::vector<Spot> spots = makeSpots(n, now);
+    benchProvider<HamQTHProvider>(bench, "hamqth", n, hamqthBody(spots));
+    benchProvider<POTAProvider>(bench, "pota", n, potaBody(spots));
+    benchProvider<SOTAProvider>(bench, "sota", n, sotaBody(spots));
+    benchProvider<WWFFProvider>(bench, "wwff", n, wwffBody(spots));
+}
+
+// how the sources turned times into UTC before spot_time.h, kept as the
+// baseline. mktime takes the timezone lock, so this is also slower with
+// TZ set
+static SpotTime libcUtc(std::tm& tm) {
+    // from https://stackoverflow.com/a/38298359
+    std::time_t tLocal = std::mktime(&tm);
+    time_t tUTC = tLocal + (std::mktime(std::localtime(&tLocal)) - std::mktime(std::gmtime(&tLocal)));
+    return std::chrono::system_clock::from_time_t(tUTC);
+}
+
+static SpotTime libcIsoTime(const std::string& s) {
+    int y, M, d, h, m;
+    float sec;
+    sscanf(s.c_str(), "%d-%d-%dT%d:%d:%f", &y, &M, &d, &h, &m, &sec);
+    std::tm tm{};
+    tm.tm_year = y - 1900;
+    tm.tm_mon = M - 1;
+    tm.tm_mday = d;
+    tm.tm_hour = h;
+    tm.tm_min = m;
+    tm.tm_sec = (int)sec;
+    return libcUtc(tm);
+}
+
+static SpotTime libcWwffTime(int date, int time) {
+    std::tm tm{};
+    tm.tm_year = date / 10000 - 1900;
+    tm.tm_mon = date / 100 % 100 - 1;
+    tm.tm_mday = date % 100;
+    tm.tm_hour = time / 100;
+    tm.tm_min = time % 100;
+    return libcUtc(tm);
+}
+
+static void benchTime(Bench& bench, size_t n, SpotTime now) {
+    std::vector<Spot> spots = makeSpots(n, now);
+    std::vector<std::string> hamqth, iso;
+    std::vector<std::pair<int, int>> wwff;
+    for (const Spot& spot : spots) {
+        hamqth.push_back(hamqthTime(spot.spotTime));
+        iso.push_back(isoTime(spot.spotTime, true));
+        int date, time;
+        wwffParts(spot.spotTime, &date, &time);
+        wwff.emplace_back(date, time);
+    }
+
+    bench.run("parse_time", n, "call", n, [&]() {
+        SpotTime t;
+        int errors = 0;
+        Clock::time_point start = Clock::now();
+        for (const std::string& s : hamqth) {
+            errors += parseTime(s, &t);
+        }
+        double elapsed = since(start);
+        sink = errors;
+        return elapsed;
+    });
+
+    bench.run("parse_iso_time", n, "call", n, [&]() {
+        SpotTime t;
+        int ok = 0;
+        Clock::time_point start = Clock::now();
+        for (const std::string& s : iso) {
+            ok += parseIsoTime(s, &t);
+        }
+        double elapsed = since(start);
+        sink = ok;
+        return elapsed;
+    });
+
+    bench.run("wwff_time", n, "call", n, [&]() {
+        SpotTime t;
+        int ok = 0;
+        Clock::time_point start = Clock::now();
+        for (const auto& dt : wwff) {
+            ok += wwffTime(dt.first, dt.second, &t);
+        }
+        double elapsed = since(start);
+        sink = ok;
+        return elapsed;
+    });
+
+    // the same through libc, to compare against
+    size_t mismatched = 0;
+    bool ran = bench.run("parse_iso_time_libc", n, "call", n, [&]() {
+        mismatched = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < iso.size(); i++) {
+            mismatched += libcIsoTime(iso[i]) != std::chrono::time_point_cast<std::chrono::seconds>(spots[i].spotTime);
+        }
+        return since(start);
+    });
+    if (ran && mismatched) {
+        flog::error("libc and parseIsoTime disagree on {0} of {1} times", mismatched, n);
+    }
+
+    bench.run("wwff_time_libc", n, "call", n, [&]() {
+        int64_t total = 0;
+        Clock::time_point start = Clock::now();
+        for (const auto& dt : wwff) {
+            total += libcWwffTime(dt.first, dt.second).time_since_epoch().count();
+        }
+        double elapsed = since(start);
+        sink = total;
+        return elapsed;
+    });
+}
+
+int main(int argc, char** argv) {
+    const char* filter = NULL;
+    double minTime = 0.25;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTime = atof(argv[++i]);
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    Bench bench(filter, minTime);
+    SpotTime now = std::chrono::system_clock::now();
+    printf("{\"benchmarks\": [");
+    for (size_t n : {1000, 10000, 100000}) {
+        benchStore(bench, n, now);
+        benchJournal(bench, n, now);
+        benchLayout(bench, n, now);
+        benchParsers(bench, n, now);
+        benchTime(bench, n, now);
+    }
+    benchMemory(bench, 50000, now);
+    printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "sources/dxcluster.h"
+
+/**********************************************
+ * Runs the DX cluster provider against a fake node on a local socket:
+ * logging in at the prompt, a line too long for the line ring being
+ * dropped without taking the next one with it, and reconnecting with a
+ * backoff that doubles while connections keep dropping.
+ *
+ * usage: spots_cluster_check, exits non zero on failure
+ **********************************************/
+
+typedef std::chrono::steady_clock Clock;
+
+static const int minBackoff = 100; // milliseconds
+
+struct Received {
+    std::mutex mtx;
+    std::vector<std::string> labels;
+
+    static void addSpots(std::vector<Spot>&& spots, void*, void* ctx) {
+        Received* _this = (Received*)ctx;
+        std::lock_guard lk(_this->mtx);
+        for (const Spot& spot : spots) {
+            _this->labels.push_back(spot.label);
+        }
+    }
+
+    bool has(const std::string& label) {
+        std::lock_guard lk(mtx);
+        return std::find(labels.begin(), labels.end(), label) != labels.end();
+    }
+};
+
+// a spot line the provider takes as current
+static std::string spotLine(const std::string& label) {
+    time_t now = time(NULL);
+    tm utc;
+    gmtime_r(&now, &utc);
+    char line[128];
+    snprintf(line, sizeof(line), "DX de W1AW:      14025.0  %-12s check            %02d%02dZ FN31\r\n",
+            label.c_str(), utc.tm_hour, utc.tm_min);
+    return line;
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+}
+
+// what the provider sends back before timeoutMs, up to a newline
+static std::string readLine(int fd, int timeoutMs) {
+    std::string line;
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (line.empty() || line.back() != '\n') {
+        int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        pollfd p = {fd, POLLIN, 0};
+        if (left <= 0 || poll(&p, 1, left) <= 0) { break; }
+        char c;
+        if (recv(fd, &c, 1, 0) != 1) { break; }
+        line += c;
+    }
+    return line;
+}
+
+// the next connection from the provider, or -1 after timeoutMs
+static int acceptOne(int listenFd, int timeoutMs) {
+    pollfd p = {listenFd, POLLIN, 0};
+    if (poll(&p, 1, timeoutMs) <= 0) { return -1; }
+    return accept(listenFd, NULL, NULL);
+}
+
+// prompt, check the login, the provider is logged in after this
+static bool login(int fd, int* failures) {
+    if (!sendAll(fd, "Welcome to the fake node\r\n\r\nPlease enter your call: ")) { return false; }
+    std::string call = readLine(fd, 2000);
+    if (call != "N0CALL\r\n") {
+        printf("FAIL: expected login as N0CALL, got \"%s\"\n", call.c_str());
+        (*failures)++;
+        return false;
+    }
+    return true;
+}
+
+static bool waitFor(Received& received, const std::string& label) {
+    for (int i = 0; i < 200; i++) {
+        if (received.has(label)) { return true; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+int main() {
+    int failures = 0;
+
+    DXClusterProvider unnamed;
+    if (unnamed.start()) {
+        printf("FAIL: started without a callsign\n");
+        failures++;
+        unnamed.stop();
+    }
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, len) != 0 || listen(listenFd, 4) != 0 ||
+            getsockname(listenFd, (sockaddr*)&addr, &len) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    Received received;
+    DXClusterProvider provider;
+    provider.minBackoff = minBackoff;
+    provider.registerAddSpots(&Received::addSpots, NULL, &received);
+    provider.setServer("127.0.0.1", ntohs(addr.sin_port), "N0CALL");
+    if (!provider.start()) {
+        printf("FAIL: didn't start with a callsign\n");
+        return 1;
+    }
+
+    // first connection: a line longer than the whole ring between two
+    // good ones, then the node hangs up
+    int fd = acceptOne(listenFd, 2000);
+    if (fd < 0 || !login(fd, &failures)) {
+        printf("FAIL: no first connection\n");
+        return 1;
+    }
+    std::string tooLong = "DX de W1AW:      14025.0  LONG         " + std::string(20000, 'x') + " 1200Z\r\n";
+    sendAll(fd, spotLine("K1BEFORE") + tooLong + spotLine("K1AFTER"));
+    if (!waitFor(received, "K1AFTER")) {
+        printf("FAIL: the line after the dropped one never arrived\n");
+        failures++;
+    }
+    if (!received.has("K1BEFORE")) {
+        printf("FAIL: the line before the dropped one never arrived\n");
+        failures++;
+    }
+    if (received.has("LONG")) {
+        printf("FAIL: a line longer than the ring came through\n");
+        failures++;
+    }
+    close(fd);
+    Clock::time_point closed = Clock::now();
+
+    // the next two connections drop right away, each reconnect waits
+    // twice as long as the last
+    for (int attempt = 0; attempt < 2; attempt++) {
+        fd = acceptOne(listenFd, 10 * minBackoff << attempt);
+        int waited = (int)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - closed).count();
+        if (fd < 0) {
+            printf("FAIL: no reconnect after %d ms\n", waited);
+            failures++;
+            break;
+        }
+        if (waited < (minBackoff << attempt)) {
+            printf("FAIL: reconnect %d after %d ms, expected at least %d\n", attempt + 1, waited, minBackoff << attempt);
+            failures++;
+        }
+        std::string label = "K" + std::to_string(attempt + 2) + "AGAIN";
+        if (login(fd, &failures)) {
+            sendAll(fd, spotLine(label));
+            if (!waitFor(received, label)) {
+                printf("FAIL: no spots after reconnect %d\n", attempt + 1);
+                failures++;
+            }
+        }
+        close(fd);
+        closed = Clock::now();
+    }
+
+    provider.stop();
+    close(listenFd);
+    if (failures == 0) { printf("ok\n"); }
+    return failures ? 1 : 0;
+}
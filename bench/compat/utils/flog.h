@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// just enough of SDR++'s flog for the module's headers to build without
+// SDR++. info and debug are dropped so they don't end up in the timings,
+// warnings and errors go to stderr
+namespace flog {
+    template <typename T>
+    std::string __toString__(const T& value) {
+        std::ostringstream ss;
+        ss << value;
+        return ss.str();
+    }
+
+    // "{0} and {1}" style, like the real thing
+    inline void __log__(const char* prefix, const char* fmt, const std::vector<std::string>& args) {
+        std::string out;
+        for (const char* p = fmt; *p; p++) {
+            size_t index;
+            if (*p == '{' && sscanf(p, "{%zu}", &index) == 1 && index < args.size()) {
+                out += args[index];
+                while (*p != '}') { p++; }
+            } else {
+                out += *p;
+            }
+        }
+        fprintf(stderr, "%s %s\n", prefix, out.c_str());
+    }
+
+    template <typename... Args>
+    void info(const char*, Args...) {}
+
+    template <typename... Args>
+    void debug(const char*, Args...) {}
+
+    template <typename... Args>
+    void warn(const char* fmt, Args... args) {
+        __log__("[WARN]", fmt, {__toString__(args)...});
+    }
+
+    template <typename... Args>
+    void error(const char* fmt, Args... args) {
+        __log__("[ERROR]", fmt, {__toString__(args)...});
+    }
+}
@@ -0,0 +1,110 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "spot_hub.h"
+#include "synthetic.h"
+
+/**********************************************
+ * Checks the hub drops a source's spots for good when it's toggled off
+ * while batches of its spots are still queued for the merge thread.
+ * Nothing is polled, spots are decoded straight into the hub.
+ *
+ * usage: spots_hub_check, exits non zero on failure
+ **********************************************/
+
+static SpotSource* findSource(SpotHub& hub, const char* name) {
+    for (auto& source : hub.sources()) {
+        if (source->name == name) { return source.get(); }
+    }
+    return NULL;
+}
+
+// spots in the latest snapshot that source reported
+static size_t countSpots(SpotHub& hub, SpotSource* source) {
+    size_t count = 0;
+    for (const SpotRecord& spot : hub.current()->spots) {
+        if (spot.sources & (1u << source->index)) { count++; }
+    }
+    return count;
+}
+
+// the merge thread takes batches in order, so once a marker batch from
+// another source shows up everything queued before it has been merged
+static bool waitMerged(SpotHub& hub, SpotSource* marker, uint32_t seed, SpotTime now) {
+    std::string body = sotaBody(makeSpots(10, now, seed, std::chrono::hours(1)));
+    size_t before = countSpots(hub, marker);
+    ((SOTAProvider*)marker->provider.get())->decode(body.data(), body.size());
+    for (int i = 0; i < 1000; i++) {
+        if (countSpots(hub, marker) != before) { return true; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+int main() {
+    char root[] = "/tmp/spots_hub_checkXXXXXX";
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    HubSettings settings;
+    settings.root = root;
+
+    int failures = 0;
+    {
+        std::shared_ptr<SpotHub> hub = SpotHub::acquire(settings);
+        SpotSource* pota = findSource(*hub, "pota");
+        SpotSource* sota = findSource(*hub, "sota");
+        SpotSource* wwff = findSource(*hub, "wwff");
+        POTAProvider* provider = (POTAProvider*)pota->provider.get();
+        // nothing listens there, the check decodes the spots itself
+        provider->setUrl("http://127.0.0.1:9/");
+        SpotTime now = std::chrono::system_clock::now();
+
+        // a big batch keeps the merge thread busy while small ones,
+        // each with rows the provider hasn't seen, queue up behind it
+        std::string big = wwffBody(makeSpots(200000, now, 1, std::chrono::hours(1)));
+        std::vector<std::string> bodies;
+        for (uint32_t seed = 1; seed <= 100; seed++) {
+            bodies.push_back(potaBody(makeSpots(10, now, seed, std::chrono::hours(1))));
+        }
+        hub->subscribe(pota);
+        ((WWFFProvider*)wwff->provider.get())->decode(big.data(), big.size());
+        for (const std::string& body : bodies) {
+            provider->decode(body.data(), body.size());
+        }
+        hub->unsubscribe(pota);
+        if (!waitMerged(*hub, sota, 1, now)) {
+            printf("FAIL: merge thread didn't catch up\n");
+            failures++;
+        }
+        size_t left = countSpots(*hub, pota);
+        if (left != 0) {
+            printf("FAIL: %zu spots of an unsubscribed source came back\n", left);
+            failures++;
+        }
+
+        // subscribed again, its spots are merged as usual
+        hub->subscribe(pota);
+        std::string body = potaBody(makeSpots(1000, now, 1000, std::chrono::hours(1)));
+        provider->decode(body.data(), body.size());
+        if (!waitMerged(*hub, sota, 2, now)) {
+            printf("FAIL: merge thread didn't catch up\n");
+            failures++;
+        }
+        if (countSpots(*hub, pota) == 0) {
+            printf("FAIL: spots of a resubscribed source were dropped\n");
+            failures++;
+        }
+        hub->unsubscribe(pota);
+    }
+
+    unlink((std::string(root) + "/spots.journal").c_str());
+    rmdir(root);
+    if (failures == 0) { printf("ok\n"); }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,593 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include "main.h"
+#include "spot_hub.h"
+#include "spot_time.h"
+#include "synthetic.h"
+
+/**********************************************
+ * Offline load test of the whole ingest path: a SpotHub, as SpotsModule
+ * uses it, with its providers pointed at a local stand-in for HamQTH,
+ * POTA, SOTA, WWFF and a DX cluster.
+ *
+ * Time is virtual: SpotClock runs --speed times faster than real time,
+ * and poll periods are scaled to match, so hours of spots go by in
+ * seconds. Each source has synthetic spots spread over the replayed
+ * hours, and the stand-in only serves a spot once virtual time reaches
+ * it, the newest --size of them per response, like the real APIs.
+ * A recorded response (--body pota=pota.json) is served as is instead.
+ *
+ * Reports JSON on stdout: ingest latency percentiles per source, from
+ * when a spot could first be served to when it was in a published
+ * snapshot, how many never made it, plus throughput and peak memory.
+ *
+ * usage: spots_replay [--hours 4] [--speed 1000] [--rate 1] [--size 200]
+ *     [--poll 15] [--lifetime 240] [--sources hamqth,pota,sota,wwff,dxcluster]
+ *     [--start 2024-01-01T00:00:00Z] [--body source=file]...
+ **********************************************/
+
+typedef std::chrono::steady_clock Clock;
+
+/**********************************************
+ * Virtual time
+ **********************************************/
+
+class ReplayClock {
+public:
+    ReplayClock(SpotTime start, double speed) : start(start), speed(speed), realStart(Clock::now()) {}
+
+    SpotTime now() const {
+        auto elapsed = std::chrono::duration<double>(Clock::now() - realStart) * speed;
+        return start + std::chrono::duration_cast<SpotTime::duration>(elapsed);
+    }
+
+    // when virtual time t comes around in real time
+    Clock::time_point realTime(SpotTime t) const {
+        auto elapsed = std::chrono::duration<double>(t - start) / speed;
+        return realStart + std::chrono::duration_cast<Clock::duration>(elapsed);
+    }
+
+    static SpotTime nowCallback(void* ctx) {
+        return ((ReplayClock*)ctx)->now();
+    }
+
+    const SpotTime start;
+    const double speed;
+    const Clock::time_point realStart;
+};
+
+/**********************************************
+ * What each source has to serve
+ **********************************************/
+
+struct ReplayFeed {
+    std::string name;
+    SpotSource* source = NULL; // the hub's
+    std::string (*body)(const std::vector<Spot>&);
+    std::vector<Spot> spots;      // in spot time order
+    std::string recorded;         // served instead, if there is one
+    SpotTime expectFrom = SpotTime::max(); // spots before this aren't expected to arrive
+
+    // filled in by the watcher
+    std::vector<Clock::time_point> arrived;
+    size_t ingested = 0;
+    size_t stored = 0; // spots that changed the store, recorded ones too
+};
+
+// spots for one source spread over the replay, with labels of their own
+static std::vector<Spot> feedSpots(const std::string& name, size_t n, SpotTime start, std::chrono::seconds span, uint32_t seed) {
+    std::vector<Spot> spots = makeSpots(n, start + span, seed, span);
+    for (Spot& spot : spots) {
+        spot.label = (char)toupper(name[0]) + spot.label;
+    }
+    std::sort(spots.begin(), spots.end(), [](const Spot& a, const Spot& b) { return a.spotTime < b.spotTime; });
+    return spots;
+}
+
+/**********************************************
+ * The stand-in server: plain HTTP/1.1 for the polled sources, and a
+ * telnet-ish line stream for the cluster, on one poll() thread
+ **********************************************/
+
+class FakeSpotServer {
+public:
+    FakeSpotServer(std::vector<std::unique_ptr<ReplayFeed>>& feeds, const ReplayClock& clock, size_t size) :
+            feeds(feeds), clock(clock), size(size) {}
+
+    ~FakeSpotServer() {
+        stop();
+    }
+
+    bool start() {
+        httpFd = listenOn(&httpPort);
+        clusterFd = listenOn(&clusterPort);
+        if (httpFd < 0 || clusterFd < 0) { return false; }
+        running = true;
+        workerThread = std::thread(&FakeSpotServer::worker, this);
+        return true;
+    }
+
+    void stop() {
+        if (!running) { return; }
+        running = false;
+        workerThread.join();
+        for (auto& conn : connections) { close(conn.fd); }
+        close(httpFd);
+        close(clusterFd);
+    }
+
+    int httpPort = 0;
+    int clusterPort = 0;
+
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> notModified{0};
+    std::atomic<uint64_t> bytesServed{0};
+    std::atomic<uint64_t> clusterLines{0};
+
+private:
+    struct Connection {
+        int fd;
+        bool cluster;
+        bool loggedIn = false;
+        size_t sent = 0;    // cluster spots sent so far
+        std::string in;
+        std::string out;
+    };
+
+    static int listenOn(int* port) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0 ||
+                getsockname(fd, (sockaddr*)&addr, &len) != 0) {
+            flog::error("replay server could not listen: {0}", strerror(errno));
+            close(fd);
+            return -1;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        *port = ntohs(addr.sin_port);
+        return fd;
+    }
+
+    ReplayFeed* feed(std::string_view name) {
+        for (auto& f : feeds) {
+            if (f->name == name) { return f.get(); }
+        }
+        return NULL;
+    }
+
+    // how many of a feed's spots have come around by now
+    size_t available(const ReplayFeed& f, SpotTime now) {
+        return std::upper_bound(f.spots.begin(), f.spots.end(), now,
+                [](SpotTime t, const Spot& s) { return t < s.spotTime; }) - f.spots.begin();
+    }
+
+    void worker() {
+        std::vector<pollfd> fds;
+        while (running) {
+            fds.clear();
+            fds.push_back({httpFd, POLLIN, 0});
+            fds.push_back({clusterFd, POLLIN, 0});
+            for (auto& conn : connections) {
+                fds.push_back({conn.fd, (short)(POLLIN | (conn.out.empty() ? 0 : POLLOUT)), 0});
+            }
+            // the cluster streams spots as time passes, so don't sleep long
+            poll(fds.data(), fds.size(), 1);
+
+            if (fds[0].revents & POLLIN) { accept(httpFd, false); }
+            if (fds[1].revents & POLLIN) { accept(clusterFd, true); }
+            for (size_t i = 2; i < fds.size(); i++) {
+                Connection& conn = connections[i - 2];
+                if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !readFrom(conn)) {
+                    close(conn.fd);
+                    conn.fd = -1;
+                }
+            }
+            SpotTime now = clock.now();
+            for (auto& conn : connections) {
+                if (conn.fd < 0) { continue; }
+                if (conn.cluster && conn.loggedIn) { streamCluster(conn, now); }
+                if (!conn.out.empty() && !writeTo(conn)) {
+                    close(conn.fd);
+                    conn.fd = -1;
+                }
+            }
+            connections.erase(std::remove_if(connections.begin(), connections.end(),
+                    [](const Connection& c) { return c.fd < 0; }), connections.end());
+        }
+    }
+
+    void accept(int listenFd, bool cluster) {
+        int fd;
+        while ((fd = ::accept(listenFd, NULL, NULL)) >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            Connection conn;
+            conn.fd = fd;
+            conn.cluster = cluster;
+            if (cluster) { conn.out = "Please enter your call: "; }
+            connections.push_back(std::move(conn));
+        }
+    }
+
+    bool readFrom(Connection& conn) {
+        char buf[4096];
+        ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) { return true; }
+        if (n <= 0) { return false; }
+        conn.in.append(buf, n);
+        if (conn.cluster) {
+            if (!conn.loggedIn && conn.in.find('\n') != conn.in.npos) {
+                // spots from now on, like a real node
+                ReplayFeed* f = feed("dxcluster");
+                SpotTime now = clock.now();
+                conn.loggedIn = true;
+                conn.sent = f ? available(*f, now) : 0;
+                if (f) { f->expectFrom = std::min(f->expectFrom, now); }
+            }
+            conn.in.clear();
+            return true;
+        }
+        size_t end;
+        while ((end = conn.in.find("\r\n\r\n")) != conn.in.npos) {
+            respond(conn, std::string_view(conn.in).substr(0, end));
+            conn.in.erase(0, end + 4);
+        }
+        return true;
+    }
+
+    bool writeTo(Connection& conn) {
+        ssize_t n = send(conn.fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL);
+        if (n < 0) { return errno == EAGAIN || errno == EINTR; }
+        conn.out.erase(0, n);
+        return true;
+    }
+
+    void respond(Connection& conn, std::string_view request) {
+        requests++;
+        // GET /name HTTP/1.1
+        size_t pathStart = request.find(' ') + 1;
+        size_t pathEnd = request.find(' ', pathStart);
+        std::string_view path = request.substr(pathStart, pathEnd - pathStart);
+        ReplayFeed* f = path.size() > 1 ? feed(path.substr(1)) : NULL;
+        if (!f) {
+            conn.out += "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+            return;
+        }
+
+        std::string body;
+        if (!f->recorded.empty()) {
+            body = f->recorded;
+        } else {
+            // the newest size spots, newest first
+            size_t end = available(*f, clock.now());
+            size_t begin = end > size ? end - size : 0;
+            std::vector<Spot> window(f->spots.rbegin() + (f->spots.size() - end), f->spots.rbegin() + (f->spots.size() - begin));
+            body = f->body(window);
+        }
+
+        char etag[32];
+        snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)fnv1a(body.data(), body.size()));
+        std::string match = "If-None-Match: " + std::string(etag);
+        if (request.find(match) != request.npos) {
+            notModified++;
+            conn.out += "HTTP/1.1 304 Not Modified\r\nETag: " + std::string(etag) + "\r\n\r\n";
+            return;
+        }
+        conn.out += "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nETag: " + std::string(etag) +
+                "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        conn.out += body;
+        bytesServed += body.size();
+    }
+
+    void streamCluster(Connection& conn, SpotTime now) {
+        ReplayFeed* f = feed("dxcluster");
+        if (!f) { return; }
+        size_t end = available(*f, now);
+        for (; conn.sent < end; conn.sent++) {
+            conn.out += clusterLine(f->spots[conn.sent]);
+            clusterLines++;
+        }
+    }
+
+    std::vector<std::unique_ptr<ReplayFeed>>& feeds;
+    const ReplayClock& clock;
+    size_t size;
+
+    int httpFd = -1;
+    int clusterFd = -1;
+    std::vector<Connection> connections;
+
+    // Threading
+    std::atomic<bool> running{false};
+    std::thread workerThread;
+};
+
+/**********************************************
+ * The store side is the hub's, merge and expiry threads included. This
+ * notes when each spot first shows up in a published snapshot, which is
+ * when the waterfall could draw it
+ **********************************************/
+
+class ReplayWatcher {
+public:
+    ReplayWatcher(SpotHub& hub) : hub(hub) {}
+
+    ~ReplayWatcher() {
+        stop();
+    }
+
+    void start() {
+        running = true;
+        workerThread = std::thread(&ReplayWatcher::worker, this);
+    }
+
+    void stop() {
+        running = false;
+        if (workerThread.joinable()) { workerThread.join(); }
+    }
+
+    // which feed spot each label is, set up before start()
+    std::unordered_map<std::string, std::pair<ReplayFeed*, size_t>> byLabel;
+    size_t peakSpots = 0;
+
+private:
+    typedef std::pair<ReplayFeed*, size_t> Target;
+
+    void worker() {
+        uint64_t version = 0;
+        while (running) {
+            std::shared_ptr<const SpotSnapshot> snapshot = hub.current();
+            if (snapshot->version != version) {
+                version = snapshot->version;
+                scan(*snapshot, Clock::now());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        // whatever the last merge published
+        scan(*hub.current(), Clock::now());
+    }
+
+    void scan(const SpotSnapshot& snapshot, Clock::time_point seen) {
+        peakSpots = std::max(peakSpots, snapshot.spots.size());
+        if (snapshot.strings != pool) {
+            // label ids are only good within a pool
+            pool = snapshot.strings;
+            targets.clear();
+            resolved.clear();
+        }
+        for (const SpotRecord& record : snapshot.spots) {
+            if (record.label >= targets.size()) {
+                targets.resize(record.label + 1, NULL);
+                resolved.resize(record.label + 1, false);
+            }
+            if (!resolved[record.label]) {
+                // recorded responses have labels we don't know
+                auto known = byLabel.find(std::string(snapshot.str(record.label)));
+                targets[record.label] = known == byLabel.end() ? NULL : &known->second;
+                resolved[record.label] = true;
+            }
+            const Target* target = targets[record.label];
+            if (!target) { continue; }
+            ReplayFeed* f = target->first;
+            if (f->arrived[target->second] == Clock::time_point()) {
+                f->arrived[target->second] = seen;
+                f->ingested++;
+            }
+        }
+    }
+
+    SpotHub& hub;
+    // by label id in pool
+    std::shared_ptr<const StringPool> pool;
+    std::vector<const Target*> targets;
+    std::vector<bool> resolved;
+
+    // Threading
+    std::atomic<bool> running{false};
+    std::thread workerThread;
+};
+
+/**********************************************
+ * Driver
+ **********************************************/
+
+static double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) { return 0; }
+    size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[i];
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+static std::string emptyBody(const std::vector<Spot>&) { return ""; }
+
+int main(int argc, char** argv) {
+    double hours = 4;
+    double speed = 1000;
+    double rate = 1;
+    size_t size = 200;
+    double pollSeconds = 15;
+    int lifetime = 240;
+    std::string sourceList = "hamqth,pota,sota,wwff,dxcluster";
+    std::string startText;
+    std::map<std::string, std::string> recorded;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--hours") { hours = atof(value.c_str()); }
+        else if (arg == "--speed") { speed = atof(value.c_str()); }
+        else if (arg == "--rate") { rate = atof(value.c_str()); }
+        else if (arg == "--size") { size = atoi(value.c_str()); }
+        else if (arg == "--poll") { pollSeconds = atof(value.c_str()); }
+        else if (arg == "--lifetime") { lifetime = atoi(value.c_str()); }
+        else if (arg == "--sources") { sourceList = value; }
+        else if (arg == "--start") { startText = value; }
+        else if (arg == "--body" && value.find('=') != value.npos) {
+            recorded[value.substr(0, value.find('='))] = readFile(value.substr(value.find('=') + 1));
+        } else {
+            fprintf(stderr, "unknown argument %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    auto span = std::chrono::seconds((int64_t)(hours * 3600));
+    SpotTime start = std::chrono::time_point_cast<std::chrono::seconds>(std::chrono::system_clock::now()) - span;
+    if (!startText.empty() && !parseIsoTime(startText, &start)) {
+        fprintf(stderr, "bad start time %s\n", startText.c_str());
+        return 1;
+    }
+
+    // spots per virtual minute, roughly what each source sees on a busy day
+    struct { const char* name; double perMinute; std::string (*body)(const std::vector<Spot>&); } known[] = {
+        {"hamqth", 20, &hamqthBody},
+        {"pota", 8, &potaBody},
+        {"sota", 2, &sotaBody},
+        {"wwff", 2, &wwffBody},
+        {"dxcluster", 30, &emptyBody}
+    };
+    std::vector<std::unique_ptr<ReplayFeed>> feeds;
+    std::unordered_map<std::string, std::pair<ReplayFeed*, size_t>> byLabel;
+    uint32_t seed = 1;
+    for (auto& k : known) {
+        seed++;
+        if (("," + sourceList + ",").find("," + std::string(k.name) + ",") == std::string::npos) { continue; }
+        auto f = std::make_unique<ReplayFeed>();
+        f->name = k.name;
+        f->body = k.body;
+        if (recorded.count(k.name)) {
+            f->recorded = recorded[k.name];
+        } else {
+            f->spots = feedSpots(k.name, (size_t)(k.perMinute * rate * hours * 60), start, span, seed);
+            f->arrived.resize(f->spots.size());
+            if (f->name != "dxcluster") { f->expectFrom = start; }
+            for (size_t i = 0; i < f->spots.size(); i++) {
+                byLabel[f->spots[i].label] = {f.get(), i};
+            }
+        }
+        feeds.push_back(std::move(f));
+    }
+
+    ReplayClock clock(start, speed);
+    SpotClock::set(&ReplayClock::nowCallback, &clock);
+    FakeSpotServer server(feeds, clock, size);
+    if (!server.start()) { return 1; }
+
+    // a hub of our own, in a scratch root so there's no journal to
+    // restore
+    char root[] = "/tmp/spots_replayXXXXXX";
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    HubSettings settings;
+    settings.root = root;
+    settings.clusterHost = "127.0.0.1";
+    settings.clusterPort = server.clusterPort;
+    settings.clusterCallsign = "N0CALL";
+    settings.maxSpotLifetime = lifetime;
+    std::shared_ptr<SpotHub> hub = SpotHub::acquire(settings);
+
+    ReplayWatcher watcher(*hub);
+    watcher.byLabel = std::move(byLabel);
+    watcher.start();
+
+    int pollPeriod = std::max(1, (int)(pollSeconds * 1000 / speed));
+    for (auto& f : feeds) {
+        for (auto& source : hub->sources()) {
+            if (source->name == f->name) { f->source = source.get(); }
+        }
+        if (f->name == "dxcluster") {
+            ((DXClusterProvider*)f->source->provider.get())->minBackoff = 10;
+        } else {
+            HTTPPoller* poller = (HTTPPoller*)f->source->provider.get();
+            poller->setUrl("http://127.0.0.1:" + std::to_string(server.httpPort) + "/" + f->name);
+            poller->setPollPeriod(pollPeriod);
+        }
+        hub->subscribe(f->source);
+    }
+    hub->subscribed();
+
+    // let it run, then give the last spots time to come in. quiet feeds
+    // get polled as slowly as four times the period
+    Clock::time_point end = clock.realTime(start + span) + std::chrono::milliseconds(5 * pollPeriod + 500);
+    std::this_thread::sleep_for(end - Clock::now());
+    watcher.stop();
+    for (auto& f : feeds) {
+        f->stored = f->source->stats.accepted;
+    }
+    size_t batches = hub->stages().back().second->items;
+    // stops the providers
+    hub.reset();
+    server.stop();
+    unlink((std::string(root) + "/spots.journal").c_str());
+    rmdir(root);
+    double elapsed = std::chrono::duration<double>(Clock::now() - clock.realStart).count();
+    SpotClock::set(NULL, NULL);
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    size_t generated = 0;
+    size_t stored = 0;
+    printf("{\n  \"sources\": [");
+    for (size_t i = 0; i < feeds.size(); i++) {
+        ReplayFeed& f = *feeds[i];
+        std::vector<double> latencies;
+        size_t expected = 0;
+        for (size_t j = 0; j < f.spots.size(); j++) {
+            if (f.spots[j].spotTime < f.expectFrom) { continue; }
+            expected++;
+            if (f.arrived[j] == Clock::time_point()) { continue; }
+            latencies.push_back(std::chrono::duration<double, std::milli>(f.arrived[j] - clock.realTime(f.spots[j].spotTime)).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        generated += f.spots.size();
+        stored += f.stored;
+        printf("%s\n    {\"name\": \"%s\", \"generated\": %zu, \"expected\": %zu, \"ingested\": %zu, \"missed\": %zu, \"stored\": %zu, "
+                "\"latency_ms\": {\"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}, \"latency_virtual_s\": {\"p50\": %.1f, \"p99\": %.1f}}",
+                i ? "," : "", f.name.c_str(), f.spots.size(), expected, latencies.size(), expected - latencies.size(), f.stored,
+                percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99), latencies.empty() ? 0 : latencies.back(),
+                percentile(latencies, 0.5) * speed / 1000, percentile(latencies, 0.99) * speed / 1000);
+    }
+    printf("\n  ],\n");
+    printf("  \"replay\": {\"hours\": %.2f, \"speed\": %.0f, \"poll_period_ms\": %d, \"elapsed_s\": %.3f, "
+            "\"spots_generated\": %zu, \"spots_stored\": %zu, \"stored_per_sec\": %.0f, \"batches\": %zu, "
+            "\"peak_store_spots\": %zu, \"peak_rss_kb\": %ld, \"http_requests\": %llu, \"http_not_modified\": %llu, "
+            "\"http_bytes\": %llu, \"cluster_lines\": %llu}\n}\n",
+            hours, speed, pollPeriod, elapsed, generated, stored, stored / elapsed, batches,
+            watcher.peakSpots, usage.ru_maxrss, (unsigned long long)server.requests, (unsigned long long)server.notModified,
+            (unsigned long long)server.bytesServed, (unsigned long long)server.clusterLines);
+    return 0;
+}
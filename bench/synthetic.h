@@ -0,0 +1,155 @@
+#ifndef __SDRPP_SPOTS_BENCH_SYNTHETIC_H
+#define __SDRPP_SPOTS_BENCH_SYNTHETIC_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include "main.h"
+#include "spot_time.h"
+
+// synthetic spots, and the responses each source would send for them
+
+static const double bandEdges[] = {1800e3, 3500e3, 7000e3, 10100e3, 14000e3, 18068e3, 21000e3, 24890e3, 28000e3};
+
+// n spots spotted over the span before newest, with unique labels
+inline std::vector<Spot> makeSpots(size_t n, SpotTime newest, uint32_t seed = 1, std::chrono::seconds span = std::chrono::hours(4)) {
+    std::mt19937 rng(seed);
+    std::vector<Spot> spots;
+    spots.reserve(n);
+    char buf[128];
+    for (size_t i = 0; i < n; i++) {
+        Spot spot;
+        snprintf(buf, sizeof(buf), "%c%zu%c%c%zu", "KWN"[i % 3], i % 10, 'A' + (char)(i % 26), 'A' + (char)(i / 26 % 26), i);
+        spot.label = buf;
+        snprintf(buf, sizeof(buf), "W%uXY%u", (unsigned)(rng() % 10), (unsigned)(rng() % 2000));
+        spot.spotter = buf;
+        double band = bandEdges[rng() % (sizeof(bandEdges) / sizeof(bandEdges[0]))];
+        spot.frequency = band + (rng() % 3000) * 100;
+        spot.spotTime = std::chrono::time_point_cast<std::chrono::seconds>(newest) - std::chrono::seconds(rng() % span.count());
+        unsigned park = rng() % 3000;
+        snprintf(buf, sizeof(buf), "K-%04u Some State Park Recreation Area", park);
+        spot.comment = buf;
+        snprintf(buf, sizeof(buf), "US-%02u", (unsigned)(rng() % 60));
+        spot.location = buf;
+        spots.push_back(std::move(spot));
+    }
+    return spots;
+}
+
+inline void timeParts(SpotTime t, int* year, int* month, int* day, int* hour, int* minute, int* second) {
+    int64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch()).count();
+    int64_t days = seconds / 86400;
+    int64_t rem = seconds % 86400;
+    *hour = rem / 3600;
+    *minute = rem / 60 % 60;
+    *second = rem % 60;
+    // civil from days, the inverse of daysFromCivil
+    days += 719468;
+    int64_t era = days / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = yoe + era * 400 + (*month <= 2);
+}
+
+// HHMM YYYY-MM-DD
+inline std::string hamqthTime(SpotTime t) {
+    int y, mo, d, h, mi, s;
+    timeParts(t, &y, &mo, &d, &h, &mi, &s);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%02d%02d %04d-%02d-%02d", h, mi, y, mo, d);
+    return buf;
+}
+
+inline std::string isoTime(SpotTime t, bool fraction) {
+    int y, mo, d, h, mi, s;
+    timeParts(t, &y, &mo, &d, &h, &mi, &s);
+    char buf[48];
+    snprintf(buf, sizeof(buf), fraction ? "%04d-%02d-%02dT%02d:%02d:%02d.123Z" : "%04d-%02d-%02dT%02d:%02d:%02d", y, mo, d, h, mi, s);
+    return buf;
+}
+
+// the minute resolution HamQTH, WWFF and the cluster have
+inline void wwffParts(SpotTime t, int* date, int* time) {
+    int y, mo, d, h, mi, s;
+    timeParts(t, &y, &mo, &d, &h, &mi, &s);
+    *date = y * 10000 + mo * 100 + d;
+    *time = h * 100 + mi;
+}
+
+// call^kHz^dx^comment^HHMM YYYY-MM-DD^lotw^eqsl^continent^band^country^dxcc
+inline std::string hamqthBody(const std::vector<Spot>& spots) {
+    std::string body;
+    char buf[512];
+    for (const Spot& spot : spots) {
+        snprintf(buf, sizeof(buf), "%s^%.1f^%s^%s^%s^^^NA^40M^%s^291\n", spot.spotter.c_str(), spot.frequency / 1000,
+                spot.label.c_str(), spot.comment.c_str(), hamqthTime(spot.spotTime).c_str(), spot.location.c_str());
+        body += buf;
+    }
+    return body;
+}
+
+inline std::string potaBody(const std::vector<Spot>& spots) {
+    std::string body = "[";
+    char buf[1024];
+    for (size_t i = 0; i < spots.size(); i++) {
+        const Spot& spot = spots[i];
+        snprintf(buf, sizeof(buf), "%s{\"spotId\":%zu,\"activator\":\"%s\",\"frequency\":\"%.1f\",\"mode\":\"CW\","
+                "\"reference\":\"K-1234\",\"parkName\":null,\"spotTime\":\"%s\",\"spotter\":\"%s\",\"comments\":\"%s\","
+                "\"source\":\"RBN\",\"invalid\":null,\"name\":\"Some State Park\",\"locationDesc\":\"%s\","
+                "\"grid4\":\"FN31\",\"grid6\":\"FN31pr\",\"latitude\":41.7,\"longitude\":-72.7,\"count\":3,\"expire\":1800}",
+                i ? "," : "", i, spot.label.c_str(), spot.frequency / 1000, isoTime(spot.spotTime, false).c_str(),
+                spot.spotter.c_str(), spot.comment.c_str(), spot.location.c_str());
+        body += buf;
+    }
+    return body + "]";
+}
+
+inline std::string sotaBody(const std::vector<Spot>& spots) {
+    std::string body = "[";
+    char buf[1024];
+    for (size_t i = 0; i < spots.size(); i++) {
+        const Spot& spot = spots[i];
+        snprintf(buf, sizeof(buf), "%s{\"id\":%zu,\"userID\":0,\"timeStamp\":\"%s\",\"comments\":\"%s\",\"callsign\":\"%s\","
+                "\"associationCode\":\"W7A\",\"summitCode\":\"W7A/AE-001\",\"activatorCallsign\":\"%s\",\"activatorName\":\"Bob\","
+                "\"frequency\":\"%.4f\",\"mode\":\"cw\",\"summitDetails\":\"%s, 1234m, 10 Points\",\"highlightColor\":null}",
+                i ? "," : "", i, isoTime(spot.spotTime, true).c_str(), spot.comment.c_str(), spot.spotter.c_str(),
+                spot.label.c_str(), spot.frequency / 1e6, spot.location.c_str());
+        body += buf;
+    }
+    return body + "]";
+}
+
+inline std::string wwffBody(const std::vector<Spot>& spots) {
+    std::string body = "{\"RCD\":[";
+    char buf[1024];
+    for (size_t i = 0; i < spots.size(); i++) {
+        const Spot& spot = spots[i];
+        int date, time;
+        wwffParts(spot.spotTime, &date, &time);
+        snprintf(buf, sizeof(buf), "%s{\"ACTIVATOR\":\"%s\",\"SPOTTER\":\"%s\",\"QRG\":\"%.1f\",\"DATE\":\"%d\",\"TIME\":\"%04d\","
+                "\"TEXT\":\"%s\",\"NAME\":\"%s\",\"REF\":\"KFF-1234\"}",
+                i ? "," : "", spot.label.c_str(), spot.spotter.c_str(), spot.frequency / 1000, date, time,
+                spot.comment.c_str(), spot.location.c_str());
+        body += buf;
+    }
+    return body + "]}";
+}
+
+// DX de SPOTTER:   14025.0  DXCALL       comment            1234Z LOC
+inline std::string clusterLine(const Spot& spot) {
+    int y, mo, d, h, mi, s;
+    timeParts(spot.spotTime, &y, &mo, &d, &h, &mi, &s);
+    char buf[256];
+    snprintf(buf, sizeof(buf), "DX de %s: %10.1f  %-12s %-30s %02d%02dZ %s\r\n", spot.spotter.c_str(), spot.frequency / 1000,
+            spot.label.c_str(), spot.comment.c_str(), h, mi, spot.location.c_str());
+    return buf;
+}
+
+#endif //__SDRPP_SPOTS_BENCH_SYNTHETIC_H
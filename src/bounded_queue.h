@@ -0,0 +1,159 @@
+#ifndef __SDRPP_SPOTS_BOUNDED_QUEUE_H
+#define __SDRPP_SPOTS_BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/**********************************************
+ * A fixed size multi-producer multi-consumer queue between pipeline
+ * stages (Vyukov's bounded queue). tryPush/tryPop never lock: each cell
+ * carries a sequence number that says whose turn it is, and producers
+ * and consumers only contend on their own end's counter.
+ *
+ * push/pop block for backpressure. They only take a lock to sleep, and
+ * only wake sleepers when there are any, so the fast path stays lock
+ * free. close() wakes everyone: pushes fail from then on and pops drain
+ * what's left, then fail.
+ **********************************************/
+template <typename T>
+class BoundedQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) { size *= 2; }
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // value is only moved from if this returns true
+    bool tryPush(T&& value) {
+        Cell* cell;
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            } else if (diff < 0) {
+                // a lap behind, full
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        wake();
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        Cell* cell;
+        size_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            } else if (diff < 0) {
+                // nothing written here yet, empty
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        wake();
+        return true;
+    }
+
+    // waits for space, returns false if closed
+    // stalled is set if it had to wait
+    bool push(T&& value, bool* stalled = NULL) {
+        if (stalled) { *stalled = false; }
+        while (!closed.load(std::memory_order_acquire)) {
+            if (tryPush(std::move(value))) { return true; }
+            if (stalled) { *stalled = true; }
+            sleep([this]() { return size() < capacity(); });
+        }
+        return false;
+    }
+
+    // waits for a value, returns false once closed and empty
+    bool pop(T& value) {
+        while (true) {
+            if (tryPop(value)) { return true; }
+            if (closed.load(std::memory_order_acquire)) {
+                // one last look, a push may have beaten the close
+                return tryPop(value);
+            }
+            sleep([this]() { return size() > 0; });
+        }
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard lk(waitMtx);
+        cv.notify_all();
+    }
+
+    // after close() and once every consumer is done, to use it again
+    void reopen() { closed.store(false, std::memory_order_release); }
+
+    // approximate while other threads push and pop
+    size_t size() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    template <typename Ready>
+    void sleep(Ready ready) {
+        std::unique_lock lk(waitMtx);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        // check again now that wakers can see us, then sleep. the timeout
+        // only matters if ready() was fooled by a half finished push/pop
+        if (!ready() && !closed.load(std::memory_order_acquire)) {
+            cv.wait_for(lk, std::chrono::milliseconds(10));
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) == 0) { return; }
+        std::lock_guard lk(waitMtx);
+        cv.notify_all();
+    }
+
+    size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<int> sleepers{0};
+    std::atomic<bool> closed{false};
+
+    // Threading
+    std::condition_variable cv;
+    std::mutex waitMtx;
+};
+
+#endif //__SDRPP_SPOTS_BOUNDED_QUEUE_H
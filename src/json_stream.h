@@ -0,0 +1,387 @@
+#ifndef __SDRPP_SPOTS_JSON_STREAM_H
+#define __SDRPP_SPOTS_JSON_STREAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// events from JSONStream
+// strings are only good for the duration of the call
+class JSONHandler {
+public:
+    virtual ~JSONHandler() {}
+    virtual void startObject() {}
+    virtual void endObject() {}
+    virtual void startArray() {}
+    virtual void endArray() {}
+    virtual void key(const std::string&) {}
+    virtual void string(const std::string&) {}
+    // numbers are passed as they appear in the text
+    virtual void number(const std::string&) {}
+    virtual void boolean(bool) {}
+    virtual void null() {}
+    // a container passed over with JSONStream::skipContainer(), as text
+    virtual void skipped(const std::string&) {}
+};
+
+/**********************************************
+ * Push (SAX style) JSON parser.
+ * Feed it the document in chunks of any size as they arrive, it keeps
+ * only the token in progress and the container stack between chunks.
+ * Stops at the first syntax error, see failed()/error().
+ *
+ * A handler can skip a container from its startObject()/startArray():
+ * the container's text is then only scanned for where it ends, without
+ * events, and handed over whole to skipped(). It isn't checked for
+ * syntax beyond balanced brackets outside strings.
+ **********************************************/
+class JSONStream {
+public:
+    JSONStream(JSONHandler* handler) : handler(handler) {}
+
+    void reset() {
+        state = State::VALUE;
+        expect = Expect::VALUE;
+        emptyOk = false;
+        containers.clear();
+        token.clear();
+        highSurrogate = 0;
+        err = NULL;
+        offset = 0;
+        skipText.clear();
+    }
+
+    // returns false once the document has failed to parse
+    bool feed(const char* data, size_t len) {
+        size_t i = 0;
+        while (i < len && !err) {
+            if (state == State::SKIP) {
+                size_t n = skip(data + i, len - i);
+                i += n;
+                offset += n;
+                continue;
+            }
+            // a char that ends a number or literal gets looked at again
+            if (step(data[i])) {
+                i++;
+                offset++;
+            }
+        }
+        return !err;
+    }
+
+    // only from startObject()/startArray(), skip the container just
+    // started
+    void skipContainer() {
+        state = State::SKIP;
+        skipText.assign(1, containers.back());
+        skipDepth = 1;
+        skipInString = false;
+        skipEscape = false;
+    }
+
+    // call at the end of the document, returns false if it was incomplete
+    bool finish() {
+        if (err) { return false; }
+        if (state == State::NUMBER || state == State::LITERAL) {
+            step(' ');
+        }
+        if (!err && (state != State::VALUE || expect != Expect::AFTER || !containers.empty())) {
+            fail("unexpected end of document");
+        }
+        return !err;
+    }
+
+    bool failed() const { return err != NULL; }
+    const char* error() const { return err ? err : ""; }
+    size_t errorOffset() const { return offset; }
+
+    // how many objects/arrays we're inside of
+    size_t depth() const { return containers.size(); }
+
+private:
+    enum class State {
+        VALUE,   // between tokens
+        STRING,
+        ESCAPE,
+        UNICODE,
+        NUMBER,
+        LITERAL,
+        SKIP     // in a skipped container
+    };
+
+    // what's allowed next, outside of a token
+    enum class Expect {
+        VALUE,
+        KEY,
+        COLON,
+        AFTER    // after a value: a separator or the end of the container
+    };
+
+    // scans a skipped container for its end, returns how much of data
+    // was part of it
+    size_t skip(const char* data, size_t len) {
+        size_t i = 0;
+        for (; i < len && skipDepth > 0; i++) {
+            char c = data[i];
+            if (skipInString) {
+                if (skipEscape) {
+                    skipEscape = false;
+                } else if (c == '\\') {
+                    skipEscape = true;
+                } else if (c == '"') {
+                    skipInString = false;
+                }
+            } else if (c == '"') {
+                skipInString = true;
+            } else if (c == '{' || c == '[') {
+                skipDepth++;
+            } else if (c == '}' || c == ']') {
+                skipDepth--;
+            }
+        }
+        skipText.append(data, i);
+        if (skipDepth == 0) {
+            state = State::VALUE;
+            containers.pop_back();
+            handler->skipped(skipText);
+            valueDone();
+        }
+        return i;
+    }
+
+    // returns false if c wasn't consumed
+    bool step(char c) {
+        switch (state) {
+        case State::VALUE:
+            structural(c);
+            return true;
+        case State::STRING:
+            if (c == '"') {
+                endString();
+            } else if (c == '\\') {
+                state = State::ESCAPE;
+            } else if ((unsigned char)c < 0x20) {
+                fail("control character in string");
+            } else {
+                token.push_back(c);
+            }
+            return true;
+        case State::ESCAPE:
+            escape(c);
+            return true;
+        case State::UNICODE:
+            unicode(c);
+            return true;
+        case State::NUMBER:
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+                token.push_back(c);
+                return true;
+            }
+            state = State::VALUE;
+            handler->number(token);
+            valueDone();
+            return false;
+        case State::LITERAL:
+            if (c >= 'a' && c <= 'z') {
+                token.push_back(c);
+                return true;
+            }
+            state = State::VALUE;
+            if (token == "true") {
+                handler->boolean(true);
+            } else if (token == "false") {
+                handler->boolean(false);
+            } else if (token == "null") {
+                handler->null();
+            } else {
+                fail("bad literal");
+                return true;
+            }
+            valueDone();
+            return false;
+        case State::SKIP:
+            // feed() hands these to skip()
+            return true;
+        }
+        return true;
+    }
+
+    void structural(char c) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            return;
+        }
+        bool inObject = !containers.empty() && containers.back() == '{';
+        switch (expect) {
+        case Expect::KEY:
+            if (c == '"') {
+                token.clear();
+                state = State::STRING;
+            } else if (c == '}' && emptyOk) {
+                close();
+            } else {
+                fail("expected key");
+            }
+            return;
+        case Expect::COLON:
+            if (c == ':') {
+                expect = Expect::VALUE;
+            } else {
+                fail("expected :");
+            }
+            return;
+        case Expect::AFTER:
+            if (containers.empty()) {
+                fail("trailing characters");
+            } else if (c == ',') {
+                expect = inObject ? Expect::KEY : Expect::VALUE;
+                emptyOk = false;
+            } else if ((c == '}' && inObject) || (c == ']' && !inObject)) {
+                close();
+            } else {
+                fail("expected , or end of container");
+            }
+            return;
+        case Expect::VALUE:
+            break;
+        }
+
+        if (c == ']' && emptyOk && !inObject) {
+            close();
+            return;
+        }
+        emptyOk = false;
+        if (c == '{') {
+            containers.push_back('{');
+            handler->startObject();
+            expect = Expect::KEY;
+            emptyOk = true;
+        } else if (c == '[') {
+            containers.push_back('[');
+            handler->startArray();
+            emptyOk = true;
+        } else if (c == '"') {
+            token.clear();
+            state = State::STRING;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            token.assign(1, c);
+            state = State::NUMBER;
+        } else if (c >= 'a' && c <= 'z') {
+            token.assign(1, c);
+            state = State::LITERAL;
+        } else {
+            fail("expected value");
+        }
+    }
+
+    void close() {
+        char container = containers.back();
+        containers.pop_back();
+        if (container == '{') {
+            handler->endObject();
+        } else {
+            handler->endArray();
+        }
+        valueDone();
+    }
+
+    void endString() {
+        state = State::VALUE;
+        if (expect == Expect::KEY) {
+            expect = Expect::COLON;
+            handler->key(token);
+        } else {
+            handler->string(token);
+            valueDone();
+        }
+    }
+
+    void escape(char c) {
+        state = State::STRING;
+        switch (c) {
+        case '"': token.push_back('"'); break;
+        case '\\': token.push_back('\\'); break;
+        case '/': token.push_back('/'); break;
+        case 'b': token.push_back('\b'); break;
+        case 'f': token.push_back('\f'); break;
+        case 'n': token.push_back('\n'); break;
+        case 'r': token.push_back('\r'); break;
+        case 't': token.push_back('\t'); break;
+        case 'u':
+            state = State::UNICODE;
+            codepoint = 0;
+            hexDigits = 0;
+            break;
+        default:
+            fail("bad escape");
+        }
+    }
+
+    void unicode(char c) {
+        int v;
+        if (c >= '0' && c <= '9') { v = c - '0'; }
+        else if (c >= 'a' && c <= 'f') { v = c - 'a' + 10; }
+        else if (c >= 'A' && c <= 'F') { v = c - 'A' + 10; }
+        else { fail("bad unicode escape"); return; }
+        codepoint = (codepoint << 4) | v;
+        if (++hexDigits < 4) { return; }
+
+        state = State::STRING;
+        if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+            // first half of a surrogate pair, wait for the second
+            highSurrogate = codepoint;
+            return;
+        }
+        uint32_t cp = codepoint;
+        if (codepoint >= 0xDC00 && codepoint <= 0xDFFF && highSurrogate) {
+            cp = 0x10000 + ((highSurrogate - 0xD800) << 10) + (codepoint - 0xDC00);
+        }
+        highSurrogate = 0;
+        appendUtf8(cp);
+    }
+
+    void appendUtf8(uint32_t cp) {
+        if (cp < 0x80) {
+            token.push_back((char)cp);
+        } else if (cp < 0x800) {
+            token.push_back((char)(0xC0 | (cp >> 6)));
+            token.push_back((char)(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            token.push_back((char)(0xE0 | (cp >> 12)));
+            token.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+            token.push_back((char)(0x80 | (cp & 0x3F)));
+        } else {
+            token.push_back((char)(0xF0 | (cp >> 18)));
+            token.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+            token.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+            token.push_back((char)(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    void valueDone() {
+        expect = Expect::AFTER;
+        emptyOk = false;
+    }
+
+    void fail(const char* e) {
+        err = e;
+    }
+
+    JSONHandler* handler;
+    State state = State::VALUE;
+    std::vector<char> containers;
+    std::string token;
+    Expect expect = Expect::VALUE;
+    bool emptyOk = false; // container was just opened
+    uint32_t codepoint = 0;
+    uint32_t highSurrogate = 0;
+    int hexDigits = 0;
+    const char* err = NULL;
+    size_t offset = 0;
+    std::string skipText;
+    int skipDepth = 0;
+    bool skipInString = false;
+    bool skipEscape = false;
+};
+
+#endif //__SDRPP_SPOTS_JSON_STREAM_H
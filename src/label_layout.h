@@ -0,0 +1,378 @@
+#ifndef __SDRPP_SPOTS_LABEL_LAYOUT_H
+#define __SDRPP_SPOTS_LABEL_LAYOUT_H
+
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include "spot_store.h"
+
+// measures label text, in pixels
+typedef float (*TextWidth)(std::string_view, void*);
+// false for spots that shouldn't be shown at all
+typedef bool (*SpotFilter)(const SpotRecord&, void*);
+
+// a label placed on the waterfall
+// centerX is in pixels relative to the layout's originFreq, so the same
+// layout can be drawn anywhere while panning
+struct PlacedLabel {
+    const SpotRecord* spot;
+    float centerX;
+    float width;
+    int lane;
+};
+
+// spots too dense to label, drawn as one count badge
+// the spots are LabelLayout::badgeMembers() from first to first + count
+struct LabelBadge {
+    float centerX;
+    float width;
+    size_t first;
+    size_t count;
+};
+
+/**********************************************
+ * Greedy lane assignment for waterfall labels, memoized.
+ * Labels are placed left to right in frequency order, each into the
+ * highest lane it fits, up to laneLimit lanes.
+ *
+ * When aggregating, displayable spots are first bucketed into binWidth
+ * pixel bins in the same pass. A bin with more spots than there are
+ * lanes can't be labelled, so it becomes one count badge without
+ * measuring any of its labels. Spots in other bins that don't find a
+ * lane go into their bin's badge instead of disappearing. Either way
+ * what's drawn is bounded by the view width, not the number of spots.
+ *
+ * The layout is computed over the view plus one view width on either
+ * side and only redone when the snapshot, zoom, width or set of
+ * displayable spots changes, or when a pan leaves that range. Otherwise
+ * drawing it is just a translation. Text widths are cached per label
+ * string id.
+ **********************************************/
+class LabelLayout {
+public:
+    typedef std::chrono::time_point<std::chrono::system_clock> TimePoint;
+
+    struct View {
+        double lowFreq;
+        double highFreq;
+        double freqToPixelRatio;
+        float width;
+    };
+
+    LabelLayout(TextWidth textWidth, void* textWidthCtx) : textWidth(textWidth), textWidthCtx(textWidthCtx) {}
+
+    // recompute the layout if anything it depends on changed
+    // spots older than displayTime are not laid out
+    // returns true if the layout was recomputed
+    bool update(const std::shared_ptr<const SpotSnapshot>& snapshot, TimePoint displayTime, const View& view) {
+        if (isValid(snapshot, displayTime, view)) {
+            return false;
+        }
+        layout(snapshot, displayTime, view);
+        return true;
+    }
+
+    // pixels to add to PlacedLabel::centerX to get the x offset in view
+    float offsetX(const View& view) const {
+        return std::round((originFreq - view.lowFreq) * laidOutView.freqToPixelRatio);
+    }
+
+    // labels that could be visible in view, in left to right order
+    std::pair<std::vector<PlacedLabel>::const_iterator, std::vector<PlacedLabel>::const_iterator> visible(const View& view) const {
+        float offset = offsetX(view);
+        float halfWidest = maxLabelWidth / 2 + padding;
+        auto first = std::lower_bound(labels.begin(), labels.end(), -offset - halfWidest,
+                [](const PlacedLabel& l, float x) { return l.centerX < x; });
+        auto last = std::upper_bound(first, labels.cend(), view.width - offset + halfWidest,
+                [](float x, const PlacedLabel& l) { return x < l.centerX; });
+        return {first, last};
+    }
+
+    // call when the font changes, cached text widths are no good anymore
+    void invalidate() {
+        widthCache.clear();
+        maxLabelWidth = 0;
+        snapshot.reset();
+    }
+
+    // badges that could be visible in view, in left to right order
+    std::pair<std::vector<LabelBadge>::const_iterator, std::vector<LabelBadge>::const_iterator> visibleBadges(const View& view) const {
+        float offset = offsetX(view);
+        auto first = std::lower_bound(badges.begin(), badges.end(), -offset - binWidth,
+                [](const LabelBadge& b, float x) { return b.centerX < x; });
+        auto last = std::upper_bound(first, badges.cend(), view.width - offset + binWidth,
+                [](float x, const LabelBadge& b) { return x < b.centerX; });
+        return {first, last};
+    }
+
+    // the spots in badge, in frequency order
+    std::pair<const SpotRecord* const*, const SpotRecord* const*> badgeMembers(const LabelBadge& badge) const {
+        const SpotRecord* const* first = members.data() + badge.first;
+        return {first, first + badge.count};
+    }
+
+    // true if the layout has any badges, they get a row above the lanes
+    bool hasBadges() const { return !badges.empty(); }
+
+    // group crowded spots into badges, or just drop what doesn't fit
+    void setAggregate(bool aggregate) {
+        if (aggregate == this->aggregate) { return; }
+        this->aggregate = aggregate;
+        relayout();
+    }
+
+    // only lay out spots filter lets through
+    void setFilter(SpotFilter filter, void* filterCtx) {
+        this->filter = filter;
+        this->filterCtx = filterCtx;
+        relayout();
+    }
+
+    // lay out again on the next update, like when the filter's answers
+    // change. what's laid out now stays usable until then
+    void relayout() { stale = true; }
+
+    const std::shared_ptr<const SpotSnapshot>& laidOutSnapshot() const { return snapshot; }
+
+    // labels in the current layout, and displayable spots without a label
+    // of their own for lack of lanes (in badges, when aggregating)
+    size_t laidOutCount() const { return labels.size(); }
+    size_t droppedCount() const { return dropped; }
+
+    int laneLimit = 8;
+    float padding = 5;  // on either side of the label text
+    float laneGap = 2;  // minimum space between labels in a lane
+    float binWidth = 32; // pixels per badge
+
+private:
+    bool isValid(const std::shared_ptr<const SpotSnapshot>& current, TimePoint displayTime, const View& view) const {
+        if (stale || !snapshot || snapshot->version != current->version) {
+            return false;
+        }
+        if (view.freqToPixelRatio != laidOutView.freqToPixelRatio || view.width != laidOutView.width) {
+            return false;
+        }
+        if (view.lowFreq < coveredLowFreq || view.highFreq > coveredHighFreq) {
+            return false;
+        }
+        // an older displayTime would show spots we skipped. a newer one
+        // only matters once it passes a spot we laid out
+        if (displayTime < laidOutDisplayTime || displayTime > oldestSpotTime) {
+            return false;
+        }
+        return true;
+    }
+
+    void layout(const std::shared_ptr<const SpotSnapshot>& current, TimePoint displayTime, const View& view) {
+        snapshot = current;
+        stale = false;
+        laidOutView = view;
+        laidOutDisplayTime = displayTime;
+        oldestSpotTime = TimePoint::max();
+        originFreq = view.lowFreq;
+        double span = view.highFreq - view.lowFreq;
+        coveredLowFreq = view.lowFreq - span;
+        coveredHighFreq = view.highFreq + span;
+
+        if (snapshot->strings != widthStrings || widthCache.size() > 2 * snapshot->spots.size() + 1024) {
+            // ids from another pool mean something else, and don't keep
+            // widths for spots long gone
+            widthCache.clear();
+            widthStrings = snapshot->strings;
+        }
+
+        labels.clear();
+        lanePositions.clear();
+        badges.clear();
+        members.clear();
+        dropped = 0;
+
+        // labels centered just outside the covered range can still poke in
+        double labelMargin = (maxLabelWidth / 2 + padding) / view.freqToPixelRatio;
+        auto end = snapshot->upperBound(coveredHighFreq + labelMargin);
+        int64_t bin = INT64_MIN;
+        for (auto it = snapshot->lowerBound(coveredLowFreq - labelMargin); it != end; ++it) {
+            const SpotRecord& spot = *it;
+            TimePoint spotTime = spot.time();
+            if (spotTime < displayTime || (filter && !filter(spot, filterCtx))) {
+                continue;
+            }
+            oldestSpotTime = std::min(oldestSpotTime, spotTime);
+
+            float centerX = std::round((spot.frequency - originFreq) * view.freqToPixelRatio);
+            if (!aggregate) {
+                place(spot, centerX);
+                continue;
+            }
+            int64_t spotBin = (int64_t)std::floor(centerX / binWidth);
+            if (spotBin != bin) {
+                flushBin(bin);
+                bin = spotBin;
+            }
+            binSpots.push_back({&spot, centerX});
+        }
+        flushBin(bin);
+    }
+
+    // lay out the spots collected for bin
+    void flushBin(int64_t bin) {
+        if (binSpots.empty()) { return; }
+        size_t first = members.size();
+        if ((int)binSpots.size() > laneLimit) {
+            // can't all fit, don't even measure them
+            for (auto& b : binSpots) { members.push_back(b.first); }
+            dropped += binSpots.size();
+        } else {
+            for (auto& b : binSpots) {
+                if (!place(*b.first, b.second)) { members.push_back(b.first); }
+            }
+        }
+        if (members.size() > first) {
+            badges.push_back({(bin + 0.5f) * binWidth, binWidth - laneGap, first, members.size() - first});
+        }
+        binSpots.clear();
+    }
+
+    // put spot in the highest lane it fits, returns false if there's none
+    bool place(const SpotRecord& spot, float centerX) {
+        float width = labelWidth(spot.label);
+        float leftEdge = centerX - (width / 2) - padding;
+        float rightEdge = centerX + (width / 2) + padding;
+
+        // choose a "lane" for the label to go in
+        // highest lane that it'll fit
+        // if none, add a lane
+        int lane = -1;
+        for (size_t i = 0; i < lanePositions.size(); i++) {
+            if (leftEdge - laneGap >= lanePositions[i]) {
+                lanePositions[i] = rightEdge;
+                lane = i;
+                break;
+            }
+        }
+        if (lane < 0) {
+            if ((int)lanePositions.size() < laneLimit) {
+                lane = lanePositions.size();
+                lanePositions.push_back(rightEdge);
+            } else {
+                // sorry, no space
+                dropped++;
+                return false;
+            }
+        }
+
+        labels.push_back({&spot, centerX, width, lane});
+        return true;
+    }
+
+    float labelWidth(uint32_t label) {
+        auto cached = widthCache.find(label);
+        if (cached != widthCache.end()) {
+            return cached->second;
+        }
+        float width = textWidth(snapshot->str(label), textWidthCtx);
+        widthCache.emplace(label, width);
+        maxLabelWidth = std::max(maxLabelWidth, width);
+        return width;
+    }
+
+    TextWidth textWidth;
+    void* textWidthCtx;
+    std::unordered_map<uint32_t, float> widthCache;
+    std::shared_ptr<const StringPool> widthStrings; // the ids are from
+    float maxLabelWidth = 0;
+
+    // what the current layout was computed from
+    std::shared_ptr<const SpotSnapshot> snapshot;
+    View laidOutView = {};
+    TimePoint laidOutDisplayTime;
+    TimePoint oldestSpotTime;
+    double originFreq = 0;
+    double coveredLowFreq = 0;
+    double coveredHighFreq = 0;
+
+    std::vector<float> lanePositions;
+    std::vector<PlacedLabel> labels;
+    size_t dropped = 0;
+
+    bool aggregate = true;
+    SpotFilter filter = NULL;
+    void* filterCtx = NULL;
+    bool stale = false;
+    std::vector<LabelBadge> badges;
+    std::vector<const SpotRecord*> members; // badge spots, badge by badge
+    // the bin being collected, spots and their centerX
+    std::vector<std::pair<const SpotRecord*, float>> binSpots;
+};
+
+// a label as drawn on the waterfall, unclamped, so we can figure out
+// clicks
+struct WaterfallLabel {
+    const SpotRecord* spot;
+    float minX;
+    float maxX;
+    float minY;
+    float maxY;
+    const LabelBadge* badge = NULL; // instead of spot
+};
+
+/**********************************************
+ * Labels drawn in the last frame, bucketed by lane. Labels in a lane
+ * never overlap and are added left to right, so finding the one under
+ * the mouse is a binary search in one lane.
+ * Buffers are reused frame to frame.
+ **********************************************/
+class LabelHitIndex {
+public:
+    void clear(float top, float laneHeight) {
+        this->top = top;
+        this->laneHeight = laneHeight;
+        for (auto& lane : lanes) {
+            lane.clear();
+        }
+    }
+
+    // labels must be added in left to right order within their lane
+    void add(int lane, const WaterfallLabel& label) {
+        if (lane >= (int)lanes.size()) {
+            lanes.resize(lane + 1);
+        }
+        lanes[lane].push_back(label);
+    }
+
+    // the label at x, y, or NULL if there's none
+    const WaterfallLabel* find(float x, float y) const {
+        if (laneHeight <= 0 || y < top) {
+            return NULL;
+        }
+        size_t lane = (size_t)((y - top) / laneHeight);
+        if (lane >= lanes.size()) {
+            return NULL;
+        }
+        const std::vector<WaterfallLabel>& labels = lanes[lane];
+        // first label starting right of x, the one before it is the only
+        // one that can contain x
+        auto it = std::upper_bound(labels.begin(), labels.end(), x,
+                [](float x, const WaterfallLabel& l) { return x < l.minX; });
+        if (it == labels.begin()) {
+            return NULL;
+        }
+        --it;
+        if (x > it->maxX || y < it->minY || y > it->maxY) {
+            return NULL;
+        }
+        return &(*it);
+    }
+
+private:
+    float top = 0;
+    float laneHeight = 0;
+    std::vector<std::vector<WaterfallLabel>> lanes;
+};
+
+#endif //__SDRPP_SPOTS_LABEL_LAYOUT_H
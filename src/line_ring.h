@@ -0,0 +1,105 @@
+#ifndef __SDRPP_SPOTS_LINE_RING_H
+#define __SDRPP_SPOTS_LINE_RING_H
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**********************************************
+ * Fixed size ring buffer for splitting a byte stream into lines.
+ * Read straight into writable() and commit(), then take lines out with
+ * nextLine(). Nothing is allocated after construction unless a line
+ * wraps around the end of the buffer, which is copied into a reused
+ * scratch string.
+ * A line longer than the whole buffer is thrown away.
+ **********************************************/
+class LineRing {
+public:
+    LineRing(size_t capacity = 8192) : buf(capacity) {}
+
+    // contiguous space to read into, may be less than all the free space
+    char* writable(size_t* len) {
+        if (count == buf.size()) {
+            // a full buffer with no newline, give up on that line
+            clear();
+            dropped = true;
+        }
+        size_t end = (start + count) % buf.size();
+        size_t free = buf.size() - count;
+        *len = std::min(free, buf.size() - end);
+        return buf.data() + end;
+    }
+
+    void commit(size_t len) {
+        count += len;
+    }
+
+    // next complete line, without the line ending, or false if there's
+    // none yet. the view is only good until the next call
+    bool nextLine(std::string_view* line) {
+        while (scanned < count) {
+            size_t i = (start + scanned) % buf.size();
+            scanned++;
+            if (buf[i] != '\n') { continue; }
+
+            size_t len = scanned - 1;
+            if (start + len <= buf.size()) {
+                *line = std::string_view(buf.data() + start, len);
+            } else {
+                size_t first = buf.size() - start;
+                scratch.assign(buf.data() + start, first);
+                scratch.append(buf.data(), len - first);
+                *line = scratch;
+            }
+            consume(scanned);
+            if (dropped) {
+                // tail end of a line we threw away
+                dropped = false;
+                continue;
+            }
+            if (!line->empty() && line->back() == '\r') {
+                line->remove_suffix(1);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // what's been received since the last complete line, which might be
+    // a prompt that never gets a newline. nothing while the rest of a
+    // line that was thrown away is still coming in
+    std::string_view partial() {
+        if (dropped) { return std::string_view(); }
+        if (start + count <= buf.size()) {
+            return std::string_view(buf.data() + start, count);
+        }
+        size_t first = buf.size() - start;
+        scratch.assign(buf.data() + start, first);
+        scratch.append(buf.data(), count - first);
+        return scratch;
+    }
+
+    void clear() {
+        start = 0;
+        count = 0;
+        scanned = 0;
+        dropped = false;
+    }
+
+private:
+    void consume(size_t len) {
+        start = (start + len) % buf.size();
+        count -= len;
+        scanned = 0;
+    }
+
+    std::vector<char> buf;
+    size_t start = 0;
+    size_t count = 0;
+    size_t scanned = 0; // bytes from start known not to be a newline
+    bool dropped = false;
+    std::string scratch;
+};
+
+#endif //__SDRPP_SPOTS_LINE_RING_H
@@ -4,6 +4,9 @@
 #include <algorithm>
 #include <vector>
 #include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <utils/freq_formatting.h>
 #include <signal_path/signal_path.h>
 #include <imgui.h>
@@ -13,11 +16,8 @@
 #include <core.h>
 #include <config.h>
 #include "main.h"
-#include "sources/hamqth.h"
-#include "sources/pota.h"
-#include "sources/sota.h"
-#include "sources/wwff.h"
-//#include "sources/server.h"
+#include "spot_hub.h"
+#include "label_layout.h"
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
 SDRPP_MOD_INFO{
@@ -60,38 +60,34 @@ std::string format_duration(std::chrono::system_clock::duration duration) {
     return std::string(buf);
 }
 
-struct SpotSource {
-    SpotSource(std::string n, std::string l, bool e, ImU32 c) : name(n), label(l), enabled(e), color(c) {}
-    SpotSource(std::string n, std::string l, bool e, ImU32 c, std::unique_ptr<SpotProvider> p, AddSpot a, void* ctx) : name(n), label(l), enabled(e), color(c), provider(std::move(p)) {
-        provider->registerAddSpot(a, this, ctx);
-    }
-    SpotSource(SpotSource&& rhs) : name(rhs.name), label(rhs.label), enabled(rhs.enabled), color(rhs.color), provider(std::move(rhs.provider)) {
-        // need to re-register as this since the old this is gone
-        provider->registerAddSpot(this);
-    }
-
-    std::string name;
-    std::string label;
-    bool enabled;
-    ImU32 color;
-    std::unique_ptr<SpotProvider> provider;
-};
+ConfigManager config;
 
-struct WaterfallSpot {
-    Spot spot;
-    SpotSource* source;
+// settings of the hub every instance shares, in their own config
+// section rather than any one instance's. the menus all edit these
+struct SharedSettings {
+    char host[1024];
+    int port = 6214;
+    int maxSpotLifetime = 240;
+    char clusterHost[1024];
+    int clusterPort = 23;
+    char clusterCallsign[32];
+    bool metricsFile = false;
 };
-
-// actual spots we're keeping track of
-// info about how we draw spots on the waterfall so we can figure out clicks
-struct WaterfallLabel {
-    WaterfallSpot* spot;
-    ImVec2 rectMin;
-    ImVec2 rectMax;
+static SharedSettings shared;
+static const char* sharedSection = "_hub";
+// they used to be per instance, the first instance to load brings its own
+static const char* sharedKeys[] = {"host", "port", "maxSpotLifetime", "clusterHost", "clusterPort", "clusterCallsign", "metricsFile"};
+
+// colors each source starts out with, the hub decides which exist
+static const std::pair<const char*, ImU32> defaultSourceColors[] = {
+    {"hamqth", IM_COL32(0x9F, 0xBB, 0xCC, 255)},
+    {"pota", IM_COL32(0xCF, 0xFD, 0xBC, 255)},
+    {"sota", IM_COL32(0xF9, 0x57, 0x38, 255)},
+    {"wwff", IM_COL32(0x29, 0x73, 0x73, 255)},
+    {"server", IM_COL32(0xE6, 0xC2, 0x29, 255)},
+    {"dxcluster", IM_COL32(0xB3, 0x9D, 0xDB, 255)},
 };
 
-ConfigManager config;
-
 class SpotsModule : public ModuleManager::Instance {
 public:
     SpotsModule(std::string name) {
@@ -99,21 +95,66 @@ public:
 
         config.acquire();
         if (!config.conf.contains(name)) {
-            config.conf[name]["host"] = "localhost";
-            config.conf[name]["port"] = 6214;
             config.conf[name]["autoStart"] = false;
             config.conf[name]["spotLifetime"] = 30;
-            config.conf[name]["maxSpotLifetime"] = 240;
             config.conf[name]["sources"] = json();
         }
+        if (!config.conf[name].contains("groupSpots")) {
+            config.conf[name]["groupSpots"] = true;
+        }
+        if (!config.conf.contains(sharedSection)) {
+            json& section = config.conf[sharedSection];
+            section["host"] = "localhost";
+            section["port"] = 6214;
+            section["maxSpotLifetime"] = 240;
+            section["clusterHost"] = "dxc.ve7cc.net";
+            section["clusterPort"] = 23;
+            section["clusterCallsign"] = "";
+            section["metricsFile"] = false;
+            for (const char* key : sharedKeys) {
+                if (config.conf[name].contains(key)) { section[key] = config.conf[name][key]; }
+            }
+        }
+        for (const char* key : sharedKeys) {
+            config.conf[name].erase(key);
+        }
 
         // config initialization
-        std::string hostname = config.conf[name]["host"];
-        strcpy(host, hostname.c_str());
-        port = config.conf[name]["port"];
         autoStart = config.conf[name]["autoStart"];
         spotLifetime = config.conf[name]["spotLifetime"];
-        maxSpotLifetime = config.conf[name]["maxSpotLifetime"];
+        groupSpots = config.conf[name]["groupSpots"];
+        labelLayout.setAggregate(groupSpots);
+        labelLayout.setFilter(&SpotsModule::showSpot, this);
+
+        json& section = config.conf[sharedSection];
+        std::string hostname = section["host"];
+        strcpy(shared.host, hostname.substr(0, sizeof(shared.host) - 1).c_str());
+        shared.port = section["port"];
+        shared.maxSpotLifetime = section["maxSpotLifetime"];
+        std::string clusterHostname = section["clusterHost"];
+        strcpy(shared.clusterHost, clusterHostname.substr(0, sizeof(shared.clusterHost) - 1).c_str());
+        shared.clusterPort = section["clusterPort"];
+        std::string callsign = section["clusterCallsign"];
+        strcpy(shared.clusterCallsign, callsign.substr(0, sizeof(shared.clusterCallsign) - 1).c_str());
+        shared.metricsFile = section["metricsFile"];
+
+        // every instance has the same settings, the first one creates
+        // the hub with them
+        HubSettings settings;
+        settings.root = core::args["root"].s();
+        settings.host = shared.host;
+        settings.port = shared.port;
+        settings.clusterHost = shared.clusterHost;
+        settings.clusterPort = shared.clusterPort;
+        settings.clusterCallsign = shared.clusterCallsign;
+        settings.maxSpotLifetime = shared.maxSpotLifetime;
+        hub = SpotHub::acquire(settings);
+        hub->setMetricsFile(shared.metricsFile);
+        hub->addRenderStats(name, &renderStats);
+        for (auto& source : hub->sources()) {
+            addSourceView(*source);
+        }
+        updateShownSources();
         config.release(true);
 
         fftRedrawHandler.ctx = this;
@@ -130,34 +171,31 @@ public:
         gui::menu.removeEntry(name);
         gui::waterfall.onFFTRedraw.unbindHandler(&fftRedrawHandler);
         gui::waterfall.onInputProcess.unbindHandler(&inputHandler);
+        stop();
+        hub->removeRenderStats(&renderStats);
+        // the last instance out stops the hub
+        hub.reset();
     }
 
-    void postInit() {
-        ImU32 color;
-        config.acquire();
-        addSource("hamqth", "HamQTH ClusterDX", false, IM_COL32(0x9F, 0xBB, 0xCC, 255), std::make_unique<HamQTHProvider>());
-        addSource("pota", "POTA.app spots", false, IM_COL32(0xCF, 0xFD, 0xBC, 255), std::make_unique<POTAProvider>());
-        addSource("sota", "SOTAwatch spots", false, IM_COL32(0xF9, 0x57, 0x38, 255), std::make_unique<SOTAProvider>());
-        addSource("wwff", "WWFF spots", false, IM_COL32(0x29, 0x73, 0x73, 255), std::make_unique<WWFFProvider>());
-        config.release(true);
-    }
+    void postInit() {}
 
     void start() {
         if (running) { return; }
-        for (auto& source : spotSources) {
-            if (source.enabled) {
-                flog::info("starting provider {0}", source.name);
-                source.provider->start();
+        for (auto& source : hub->sources()) {
+            if (views[source->index].enabled) {
+                hub->subscribe(source.get());
             }
         }
+        hub->subscribed();
         running = true;
     }
 
     void stop() {
         if (!running) { return; }
-        for (auto& source : spotSources) {
-            flog::info("stopping provider {0}", source.name);
-            source.provider->stop();
+        for (auto& source : hub->sources()) {
+            if (views[source->index].enabled) {
+                hub->unsubscribe(source.get());
+            }
         }
         running = false;
     }
@@ -179,20 +217,29 @@ private:
         SpotsModule* _this = (SpotsModule*)ctx;
         float menuWidth = ImGui::GetContentRegionAvail().x;
 
-        /*if (_this->running) { style::beginDisabled(); }
-        if (ImGui::InputText(CONCAT("##_spots_host_", _this->name), _this->host, 1023)) {
+#ifdef __linux__
+        // where the local spot server listens, for every instance
+        if (_this->running) { style::beginDisabled(); }
+        bool listenChanged = false;
+        if (ImGui::InputText(CONCAT("##_spots_host_", _this->name), shared.host, sizeof(shared.host) - 1)) {
             config.acquire();
-            config.conf[_this->name]["host"] = std::string(_this->host);
+            config.conf[sharedSection]["host"] = std::string(shared.host);
             config.release(true);
+            listenChanged = true;
         }
         ImGui::SameLine();
         ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
-        if (ImGui::InputInt(CONCAT("##_spots_port_", _this->name), &_this->port, 0, 0)) {
+        if (ImGui::InputInt(CONCAT("##_spots_port_", _this->name), &shared.port, 0, 0)) {
             config.acquire();
-            config.conf[_this->name]["port"] = _this->port;
+            config.conf[sharedSection]["port"] = shared.port;
             config.release(true);
+            listenChanged = true;
+        }
+        if (listenChanged) {
+            _this->hub->setListen(shared.host, shared.port);
         }
-        if (_this->running) { style::endDisabled(); }*/
+        if (_this->running) { style::endDisabled(); }
+#endif
 
         if (ImGui::Checkbox(CONCAT("Listen on startup##_spots_auto_lst_", _this->name), &_this->autoStart)) {
             config.acquire();
@@ -202,12 +249,19 @@ private:
 
         ImGui::LeftLabel("Spot Lifetime");
         ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
-        if (ImGui::SliderInt(("##_spots_spotlifetime_" + _this->name).c_str(), &_this->spotLifetime, 1, _this->maxSpotLifetime)) {
+        if (ImGui::SliderInt(("##_spots_spotlifetime_" + _this->name).c_str(), &_this->spotLifetime, 1, _this->hub->maxSpotLifetime())) {
             config.acquire();
             config.conf[_this->name]["spotLifetime"] = _this->spotLifetime;
             config.release(true);
         }
 
+        if (ImGui::Checkbox(CONCAT("Group crowded spots##_spots_group_", _this->name), &_this->groupSpots)) {
+            config.acquire();
+            config.conf[_this->name]["groupSpots"] = _this->groupSpots;
+            config.release(true);
+            _this->labelLayout.setAggregate(_this->groupSpots);
+        }
+
         // compute enable button size
         ImVec2 cellpad = ImGui::GetStyle().CellPadding;
         float lheight = ImGui::GetTextLineHeight();
@@ -220,46 +274,87 @@ private:
             ImGui::TableSetupScrollFreeze(3, 1);
             ImGui::TableHeadersRow();
 
-            for(auto& source : _this->spotSources) {
+            for(auto& source : _this->hub->sources()) {
+                SourceView& view = _this->views[source->index];
                 ImGui::TableNextRow();
 
                 ImGui::TableSetColumnIndex(0);
-                ImGui::TextUnformatted(source.label.c_str());
+                ImGui::TextUnformatted(source->label.c_str());
+                if (source->stats.startFailed) {
+                    ImGui::SameLine();
+                    ImGui::TextColored(ImVec4(1.0, 0.0, 0.0, 1.0), "(not started)");
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("%s", source->name == "dxcluster" ? "Set a callsign to log in with below" : "Could not start, see the log");
+                    }
+                }
 
                 ImGui::TableSetColumnIndex(1);
-                ImVec4 color = ImGui::ColorConvertU32ToFloat4(source.color);
-                if (ImGui::ColorEdit4(CONCAT("##_spots_color_", source.name + _this->name), (float*)&color, ImGuiColorEditFlags_NoInputs)) {
-                    source.color = ImGui::ColorConvertFloat4ToU32(color);
+                ImVec4 color = ImGui::ColorConvertU32ToFloat4(view.color);
+                if (ImGui::ColorEdit4(CONCAT("##_spots_color_", source->name + _this->name), (float*)&color, ImGuiColorEditFlags_NoInputs)) {
+                    view.color = ImGui::ColorConvertFloat4ToU32(color);
                     config.acquire();
-                    config.conf[_this->name]["sources"][source.name]["enabled"] = source.color;
+                    config.conf[_this->name]["sources"][source->name]["color"] = view.color;
                     config.release(true);
                 }
 
                 ImGui::TableSetColumnIndex(2);
-                if(ImGui::Checkbox(CONCAT("##_spots_", source.name + _this->name), &(source.enabled))) {
+                if(ImGui::Checkbox(CONCAT("##_spots_", source->name + _this->name), &view.enabled)) {
                     config.acquire();
-                    config.conf[_this->name]["sources"][source.name]["enabled"] = source.enabled;
+                    config.conf[_this->name]["sources"][source->name]["enabled"] = view.enabled;
                     config.release(true);
-                    if (source.enabled && _this->running) {
-                        source.provider->start();
-                    } else {
-                        source.provider->stop();
-
-                        // remove any spots from that source
-                        std::lock_guard lk(_this->waterfallMutex);
-                        for (auto it = _this->waterfallSpots.begin(); it != _this->waterfallSpots.end();) {
-                            if (it->source == &source) {
-                                it = _this->waterfallSpots.erase(it);
-                            } else {
-                                it++;
-                            }
+                    if (_this->running) {
+                        if (view.enabled) {
+                            _this->hub->subscribe(source.get());
+                        } else {
+                            _this->hub->unsubscribe(source.get());
                         }
                     }
+                    // other instances may still be showing its spots
+                    _this->updateShownSources();
+                    _this->labelLayout.relayout();
                 }
             }
             ImGui::EndTable();
         }
 
+#ifndef _WIN32
+        // where the dx cluster source connects, for every instance
+        if (_this->running) { style::beginDisabled(); }
+        ImGui::LeftLabel("Cluster");
+        ImGui::SetNextItemWidth(menuWidth * 0.65f - ImGui::GetCursorPosX());
+        bool clusterChanged = false;
+        if (ImGui::InputText(CONCAT("##_spots_cluster_host_", _this->name), shared.clusterHost, sizeof(shared.clusterHost) - 1)) {
+            config.acquire();
+            config.conf[sharedSection]["clusterHost"] = std::string(shared.clusterHost);
+            config.release(true);
+            clusterChanged = true;
+        }
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        if (ImGui::InputInt(CONCAT("##_spots_cluster_port_", _this->name), &shared.clusterPort, 0, 0)) {
+            config.acquire();
+            config.conf[sharedSection]["clusterPort"] = shared.clusterPort;
+            config.release(true);
+            clusterChanged = true;
+        }
+        ImGui::LeftLabel("Callsign");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        if (ImGui::InputText(CONCAT("##_spots_cluster_call_", _this->name), shared.clusterCallsign, sizeof(shared.clusterCallsign) - 1)) {
+            config.acquire();
+            config.conf[sharedSection]["clusterCallsign"] = std::string(shared.clusterCallsign);
+            config.release(true);
+            clusterChanged = true;
+        }
+        if (clusterChanged) {
+            _this->hub->setCluster(shared.clusterHost, shared.clusterPort, shared.clusterCallsign);
+        }
+        if (_this->running) { style::endDisabled(); }
+#endif
+
+        if (ImGui::CollapsingHeader(CONCAT("Metrics##_spots_metrics_", _this->name))) {
+            _this->drawMetrics();
+        }
+
         ImGui::FillWidth();
 
         //start/stop server
@@ -283,91 +378,120 @@ private:
 
     static void fftRedraw(ImGui::WaterFall::FFTRedrawArgs args, void* ctx) {
         SpotsModule* _this = (SpotsModule*)ctx;
+        auto redrawStart = std::chrono::steady_clock::now();
+
+        // spots older than this are still kept (until they expire) but
+        // not drawn
+        auto displayTime = SpotClock::now() - std::chrono::minutes(_this->spotLifetime);
+
+        float textHeight = ImGui::CalcTextSize("TEST").y;
+        float laneHeight = textHeight + 2;
+        if (textHeight != _this->labelTextHeight) {
+            // font changed, so did all the label widths
+            _this->labelLayout.invalidate();
+            _this->labelTextHeight = textHeight;
+        }
 
-        std::lock_guard lk(_this->waterfallMutex);
-        auto expirationTime = std::chrono::system_clock::now() - std::chrono::minutes(_this->maxSpotLifetime);
-        auto displayTime = std::chrono::system_clock::now() - std::chrono::minutes(_this->spotLifetime);
+        // no locking, just lay out whatever snapshot of spots is current.
+        // the layout holds on to it so fftInput can refer to the spots we
+        // drew. most frames this doesn't lay out anything
+        LabelLayout::View view = {args.lowFreq, args.highFreq, args.freqToPixelRatio, args.max.x - args.min.x};
+        _this->labelLayout.update(_this->hub->current(), displayTime, view);
 
-        std::vector<float> lanePositions;
-        float laneHeight = ImGui::CalcTextSize("TEST").y + 2;
-        int laneLimit = 8;
-        _this->waterfallLabels.clear();
+        _this->waterfallLabels.clear(args.min.y, laneHeight);
         double waterfallFreq = gui::waterfall.getCenterFrequency();
         waterfallFreq += sigpath::vfoManager.getOffset(gui::waterfall.selectedVFO);
-        for (auto it = _this->waterfallSpots.begin(); it != _this->waterfallSpots.end();) {
-
-            // handle expiration of spots
-            if(it->spot.spotTime < displayTime) {
-                if(it->spot.spotTime < expirationTime) {
-                    it = _this->waterfallSpots.erase(it);
-                } else {
-                    ++it;
-                }
-                continue;
-            }
 
-            // skip spots outside waterfall frequency range
-            if (it->spot.frequency < args.lowFreq && it->spot.frequency < args.highFreq) {
-                ++it;
-                continue;
-            }
+        const SpotSnapshot& snapshot = *_this->labelLayout.laidOutSnapshot();
+        float offsetX = args.min.x + _this->labelLayout.offsetX(view);
+        size_t drawn = 0;
+
+        // crowded stretches get a count badge in a row of their own
+        int laneOffset = _this->labelLayout.hasBadges() ? 1 : 0;
+        auto badges = _this->labelLayout.visibleBadges(view);
+        for (auto it = badges.first; it != badges.second; ++it) {
+            float centerXpos = offsetX + it->centerX;
+            ImVec2 rectMin = ImVec2(centerXpos - it->width / 2, args.min.y);
+            ImVec2 rectMax = ImVec2(centerXpos + it->width / 2, args.min.y + textHeight);
+            if (rectMax.x < args.min.x || rectMin.x > args.max.x) { continue; }
+            ImVec2 clampedRectMin = ImVec2(std::max(rectMin.x, args.min.x), rectMin.y);
+            ImVec2 clampedRectMax = ImVec2(std::min(rectMax.x, args.max.x), rectMax.y);
+
+            WaterfallLabel hit = {NULL, rectMin.x, rectMax.x, rectMin.y, rectMax.y};
+            hit.badge = &*it;
+            _this->waterfallLabels.add(0, hit);
+            args.window->DrawList->AddRectFilled(clampedRectMin, clampedRectMax, _this->spotBadgeColor);
+            char count[16];
+            snprintf(count, sizeof(count), "%zu", it->count);
+            float countWidth = ImGui::CalcTextSize(count).x;
+            args.window->DrawList->AddText(ImVec2(centerXpos - countWidth / 2, args.min.y), _this->spotTextColor, count);
+        }
 
-            double centerXpos = args.min.x + std::round((it->spot.frequency - args.lowFreq) * args.freqToPixelRatio);
-
-            ImVec2 nameSize = ImGui::CalcTextSize(it->spot.label.c_str());
-            float leftEdge = centerXpos - (nameSize.x/2) - 5;
-            float rightEdge = centerXpos + (nameSize.x/2) + 5;
-
-            // choose a "lane" for the label to go in
-            // highest lane that it'll fit
-            // if none, add a lane
-            float targetY = -1;
-            int i = 0;
-            for(auto laneIt = lanePositions.begin(); laneIt != lanePositions.end(); laneIt++) {
-                if(leftEdge - 2 >= *laneIt) {
-                    *laneIt = rightEdge;
-                    targetY = args.min.y + i * laneHeight;
-                    break;
-                }
-                i++;
-            }
-            if(targetY < 0) {
-                if(i < laneLimit) {
-                    targetY = args.min.y + i * laneHeight;
-                    lanePositions.push_back(rightEdge);
-                } else {
-                    // sorry, no space
-                    ++it;
-                    continue;
-                }
-            }
+        auto visible = _this->labelLayout.visible(view);
+        for (auto it = visible.first; it != visible.second; ++it) {
+            const SpotRecord& spot = *it->spot;
+            int lane = it->lane + laneOffset;
+            float centerXpos = offsetX + it->centerX;
+            float targetY = args.min.y + lane * laneHeight;
 
-            ImU32 bgColor = it->source->color;
+            ImU32 bgColor = _this->spotColor(spot);
 
-            if (it->spot.frequency >= args.lowFreq && it->spot.frequency <= args.highFreq) {
+            if (spot.frequency >= args.lowFreq && spot.frequency <= args.highFreq) {
                 args.window->DrawList->AddLine(ImVec2(centerXpos, targetY), ImVec2(centerXpos, args.max.y), bgColor);
             }
 
-            ImVec2 rectMin = ImVec2(centerXpos - (nameSize.x / 2) - 5, targetY);
-            ImVec2 rectMax = ImVec2(centerXpos + (nameSize.x / 2) + 5, targetY + nameSize.y);
+            ImVec2 rectMin = ImVec2(centerXpos - (it->width / 2) - 5, targetY);
+            ImVec2 rectMax = ImVec2(centerXpos + (it->width / 2) + 5, targetY + textHeight);
             ImVec2 clampedRectMin = ImVec2(std::clamp<double>(rectMin.x, args.min.x, args.max.x), rectMin.y);
             ImVec2 clampedRectMax = ImVec2(std::clamp<double>(rectMax.x, args.min.x, args.max.x), rectMax.y);
 
             if (clampedRectMax.x - clampedRectMin.x > 0) {
-                _this->waterfallLabels.push_back({&(*it), rectMin, rectMax});
-                if (almost_equal(waterfallFreq, it->spot.frequency)) {
+                drawn++;
+                _this->waterfallLabels.add(lane, {&spot, rectMin.x, rectMax.x, rectMin.y, rectMax.y});
+                if (almost_equal(waterfallFreq, (double)spot.frequency)) {
                     args.window->DrawList->AddRectFilledMultiColor(clampedRectMin, clampedRectMax, bgColor, bgColor, _this->spotBgColorSelected, bgColor);
                 } else {
                     args.window->DrawList->AddRectFilled(clampedRectMin, clampedRectMax, bgColor);
                 }
-                args.window->DrawList->AddText(ImVec2(centerXpos - (nameSize.x / 2), targetY), _this->spotTextColor, it->spot.label.c_str());
+                std::string_view label = snapshot.str(spot.label);
+                args.window->DrawList->AddText(ImVec2(centerXpos - (it->width / 2), targetY), _this->spotTextColor, label.data(), label.data() + label.size());
             }
+        }
+
+        _this->renderStats.labelsVisible = drawn;
+        _this->renderStats.labelsLaidOut = _this->labelLayout.laidOutCount();
+        _this->renderStats.labelsDropped = _this->labelLayout.droppedCount();
+        _this->renderStats.redrawTime.observeSince(redrawStart);
+    }
+
+    // only spots some source this instance shows reported
+    static bool showSpot(const SpotRecord& spot, void* ctx) {
+        SpotsModule* _this = (SpotsModule*)ctx;
+        return (spot.sources & _this->shownSources) != 0;
+    }
+
+    // the color of the latest report's source, or if that isn't shown
+    // here, of a shown source that reported it too
+    ImU32 spotColor(const SpotRecord& spot) const {
+        const SourceView& latest = views[spot.source->index];
+        if (latest.enabled) { return latest.color; }
+        for (size_t i = 0; i < views.size(); i++) {
+            if (views[i].enabled && spot.reportedBy(i)) { return views[i].color; }
+        }
+        return latest.color;
+    }
 
-            // make sure to get the next element in the spot list!
-            ++it;
+    void updateShownSources() {
+        shownSources = 0;
+        for (size_t i = 0; i < views.size() && i < SpotStore::maxSources; i++) {
+            if (views[i].enabled) { shownSources |= 1u << i; }
         }
     }
 
+    static float labelTextWidth(std::string_view label, void* ctx) {
+        return ImGui::CalcTextSize(label.data(), label.data() + label.size()).x;
+    }
+
     // stuff to check if we click on a label on the waterfall
     // inspired by freuqency_manager module
     bool mouseAlreadyDown = false;
@@ -386,14 +510,16 @@ private:
         bool inALabel = false;
         WaterfallLabel hoveredLabel;
 
-        for(auto label : _this->waterfallLabels) {
-            ImVec2 clampedRectMin = ImVec2(std::clamp<double>(label.rectMin.x, args.fftRectMin.x, args.fftRectMax.x), label.rectMin.y);
-            ImVec2 clampedRectMax = ImVec2(std::clamp<double>(label.rectMax.x, args.fftRectMin.x, args.fftRectMax.x), label.rectMax.y);
-
-            if (ImGui::IsMouseHoveringRect(clampedRectMin, clampedRectMax)) {
-                inALabel = true;
-                hoveredLabel = label;
-                break;
+        ImVec2 mousePos = ImGui::GetMousePos();
+        if (mousePos.x >= args.fftRectMin.x && mousePos.x <= args.fftRectMax.x) {
+            const WaterfallLabel* label = _this->waterfallLabels.find(mousePos.x, mousePos.y);
+            if (label) {
+                ImVec2 clampedRectMin = ImVec2(std::clamp<double>(label->minX, args.fftRectMin.x, args.fftRectMax.x), label->minY);
+                ImVec2 clampedRectMax = ImVec2(std::clamp<double>(label->maxX, args.fftRectMin.x, args.fftRectMax.x), label->maxY);
+                if (ImGui::IsMouseHoveringRect(clampedRectMin, clampedRectMax)) {
+                    inALabel = true;
+                    hoveredLabel = *label;
+                }
             }
         }
 
@@ -411,104 +537,162 @@ private:
 
         gui::waterfall.inputHandled = true;
 
-        ImVec2 clampedRectMin = ImVec2(std::clamp<double>(hoveredLabel.rectMin.x, args.fftRectMin.x, args.fftRectMax.x), hoveredLabel.rectMin.y);
-        ImVec2 clampedRectMax = ImVec2(std::clamp<double>(hoveredLabel.rectMax.x, args.fftRectMin.x, args.fftRectMax.x), hoveredLabel.rectMax.y);
+        if (hoveredLabel.badge) {
+            _this->badgeTooltip(*hoveredLabel.badge);
+            return;
+        }
 
         if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
             _this->mouseClickedInLabel = true;
-            tuner::tune(tuner::TUNER_MODE_NORMAL, gui::waterfall.selectedVFO, hoveredLabel.spot->spot.frequency);
+            tuner::tune(tuner::TUNER_MODE_NORMAL, gui::waterfall.selectedVFO, (double)hoveredLabel.spot->frequency);
         }
 
+        // the labels point into the snapshot the layout holds
+        const SpotSnapshot& snapshot = *_this->labelLayout.laidOutSnapshot();
+        const SpotRecord& record = *hoveredLabel.spot;
+        Spot spot = snapshot.spot(record);
+        std::string spotters;
+        for (size_t i = 0; i < record.spotterCount; i++) {
+            if (i > 0) { spotters += ", "; }
+            spotters += snapshot.str(record.spotters[i]);
+        }
+        std::string sources;
+        for (auto& source : _this->hub->sources()) {
+            if (!record.reportedBy(source->index)) { continue; }
+            if (!sources.empty()) { sources += ", "; }
+            sources += source->label;
+        }
         ImGui::BeginTooltip();
-        ImGui::TextUnformatted(hoveredLabel.spot->spot.label.c_str());
+        ImGui::TextUnformatted(spot.label.c_str());
         ImGui::Separator();
-        ImGui::Text("Frequency: %s", utils::formatFreq(hoveredLabel.spot->spot.frequency).c_str());
-        ImGui::Text("Location: %s", hoveredLabel.spot->spot.location.c_str());
-        ImGui::Text("Spotter: %s", hoveredLabel.spot->spot.spotter.c_str());
-        std::string lastSpotted = format_duration(std::chrono::system_clock::now() - hoveredLabel.spot->spot.spotTime) + " ago";
+        ImGui::Text("Frequency: %s", utils::formatFreq(spot.frequency).c_str());
+        ImGui::Text("Location: %s", spot.location.c_str());
+        ImGui::Text("Spotted by: %s", spotters.c_str());
+        ImGui::Text("Sources: %s", sources.c_str());
+        std::string lastSpotted = format_duration(SpotClock::now() - spot.spotTime) + " ago";
         ImGui::Text("Last spotted: %s", lastSpotted.c_str());
-        ImGui::Text("Comment: %s", hoveredLabel.spot->spot.comment.c_str());
+        ImGui::Text("Comment: %s", spot.comment.c_str());
         ImGui::EndTooltip();
     }
 
-    static void addSpot(Spot providedSpot, void* sourceCtx, void* ctx) {
-        SpotSource* source = (SpotSource*) sourceCtx;
-        SpotsModule* _this = (SpotsModule*) ctx;
-        std::lock_guard lk(_this->waterfallMutex);
-
-        if(providedSpot.spotTime < std::chrono::system_clock::now() - std::chrono::minutes(_this->maxSpotLifetime)) {
-            // silently drop already expired spots
-            return;
+    // what's in a badge, in frequency order
+    void badgeTooltip(const LabelBadge& badge) {
+        const SpotSnapshot& snapshot = *labelLayout.laidOutSnapshot();
+        auto spots = labelLayout.badgeMembers(badge);
+        ImGui::BeginTooltip();
+        ImGui::Text("%zu spots", badge.count);
+        ImGui::Separator();
+        size_t shown = 0;
+        for (auto it = spots.first; it != spots.second && shown < maxBadgeTooltipSpots; ++it, ++shown) {
+            const SpotRecord& spot = **it;
+            std::string_view label = snapshot.str(spot.label);
+            ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(spotColor(spot)), "%.*s", (int)label.size(), label.data());
+            ImGui::SameLine();
+            ImGui::Text("%s", utils::formatFreq(spot.frequency).c_str());
         }
-        WaterfallSpot spot = {providedSpot, source};
-        // find a spot with a matching label (callsign)
-        // we'll re-add it to the list in case the frequency changed
-        // so waterfallSpots always stays in frequency order
-        auto it = std::find_if(
-                _this->waterfallSpots.begin(),
-                _this->waterfallSpots.end(),
-                [&spot](const WaterfallSpot& s) { return s.spot.label == spot.spot.label; }
-        );
-        if (it != _this->waterfallSpots.end()) {
-            if(it->spot.spotTime > spot.spot.spotTime) {
-                // more recent spot takes precedence
-                spot = *it;
-            }
-            _this->waterfallSpots.erase(it);
-        }
-        _this->waterfallSpots.insert(
-            std::lower_bound(
-                _this->waterfallSpots.begin(),
-                _this->waterfallSpots.end(),
-                spot.spot.frequency,
-                [](const WaterfallSpot &lhs, double f) { return lhs.spot.frequency < f; }
-            ),
-            spot
-        );
+        if (badge.count > shown) {
+            ImGui::Text("and %zu more", badge.count - shown);
+        }
+        ImGui::EndTooltip();
     }
 
-    void addSource(std::string sourceName, std::string label, bool defaultEnabled, ImU32 defaultColor, std::unique_ptr<SpotProvider>&& provider) {
-        flog::info("initializing source {0}", sourceName);
-        if (!config.conf[name]["sources"].contains(sourceName)) {
-            config.conf[name]["sources"][sourceName] = json(json::value_t::object);
+    void drawMetrics() {
+        if (ImGui::Checkbox(CONCAT("Write metrics file##_spots_metrics_file_", name), &shared.metricsFile)) {
+            config.acquire();
+            config.conf[sharedSection]["metricsFile"] = shared.metricsFile;
+            config.release(true);
+            hub->setMetricsFile(shared.metricsFile);
         }
-        json sourceConf = config.conf[name]["sources"][sourceName];
 
-        flog::info("getting params");
-        ImU32 color = sourceConf.value("color", defaultColor);
-        sourceConf["color"] = color;
-        bool enabled = sourceConf.value("enabled", defaultEnabled);
-        sourceConf["enabled"] = enabled;
+        for (auto& source : hub->sources()) {
+            const ProviderStats& p = source->provider->stats();
+            const SourceStats& s = source->stats;
+            if (p.fetches == 0 && p.rowsDecoded == 0) { continue; }
+            ImGui::Separator();
+            ImGui::TextUnformatted(source->label.c_str());
+            ImGui::Text("Fetch: %.0f/%.0f ms p50/p99, %llu failed (%llu in a row)",
+                    p.fetchLatency.quantile(0.5) * 1e3, p.fetchLatency.quantile(0.99) * 1e3,
+                    (unsigned long long)p.failures, (unsigned long long)p.consecutiveFailures);
+            if (p.pollInterval > 0) {
+                ImGui::Text("Polling every %.1f s", p.pollInterval / 1e3);
+            }
+            ImGui::Text("Received: %.1f kB, parse %.2f ms p99",
+                    p.bytesReceived / 1e3, p.parseTime.quantile(0.99) * 1e3);
+            ImGui::Text("Rows: %llu decoded, %llu seen, %llu bad, %llu filtered",
+                    (unsigned long long)p.rowsDecoded, (unsigned long long)p.rowsSkipped,
+                    (unsigned long long)p.rowsInvalid, (unsigned long long)p.rowsFiltered);
+            ImGui::Text("Spots: %llu accepted, %llu deduped, %llu expired, %llu dropped",
+                    (unsigned long long)s.accepted, (unsigned long long)s.deduped,
+                    (unsigned long long)s.expired, (unsigned long long)s.dropped);
+            ImGui::Text("Lock wait: %.2f ms p99, shown by %d instances", s.lockWait.quantile(0.99) * 1e3, source->subscribers.load());
+        }
 
-        flog::info("emplacing");
-        spotSources.emplace_back(sourceName, label, enabled, color,
-                std::move(provider), &SpotsModule::addSpot, this);
-    }
+        ImGui::Separator();
+        const RenderStats& r = renderStats;
+        ImGui::Text("Redraw: %.2f/%.2f ms p50/p99", r.redrawTime.quantile(0.5) * 1e3, r.redrawTime.quantile(0.99) * 1e3);
+        ImGui::Text("Labels: %llu visible, %llu laid out, %llu without a label",
+                (unsigned long long)r.labelsVisible, (unsigned long long)r.labelsLaidOut, (unsigned long long)r.labelsDropped);
 
+        ImGui::Separator();
+        for (auto& stage : hub->stages()) {
+            ImGui::Text("%s: %llu queued, wait %.2f ms p99, %.2f ms p99 each, %llu stalls", stage.first,
+                    (unsigned long long)stage.second->depth, stage.second->queueWait.quantile(0.99) * 1e3,
+                    stage.second->processTime.quantile(0.99) * 1e3, (unsigned long long)stage.second->stalls);
+        }
+    }
 
-    char host[1024];
-    int port = 6214;
+    // this instance's color and checkbox for a source, from its config
+    void addSourceView(const SpotSource& source) {
+        ImU32 defaultColor = IM_COL32(0xCF, 0xFD, 0xBC, 255);
+        for (auto& c : defaultSourceColors) {
+            if (source.name == c.first) { defaultColor = c.second; }
+        }
+        if (!config.conf[name]["sources"].contains(source.name)) {
+            config.conf[name]["sources"][source.name] = json(json::value_t::object);
+        }
+        json& sourceConf = config.conf[name]["sources"][source.name];
+        SourceView view;
+        view.color = sourceConf.value("color", defaultColor);
+        sourceConf["color"] = view.color;
+        view.enabled = sourceConf.value("enabled", false);
+        sourceConf["enabled"] = view.enabled;
+        views.push_back(view);
+    }
 
     std::string name;
     bool enabled = true;
     bool running = false;
 
     int spotLifetime = 30; // don't display stuff older than this in minutes
-    int maxSpotLifetime = 240; // drop spots older than this in minutes
     ImU32 spotBgColor = IM_COL32(0xCF, 0xFD, 0xBC ,255);
     ImU32 spotBgColorSelected = IM_COL32(0xFB, 0xAF, 0x00, 255);
     ImU32 spotTextColor = IM_COL32(0, 0, 0, 255);
+    ImU32 spotBadgeColor = IM_COL32(0xDD, 0xDD, 0xDD, 255);
+    static constexpr size_t maxBadgeTooltipSpots = 20;
 
     bool autoStart = false;
+    bool groupSpots = true; // count badges where there are too many to label
 
     EventHandler<ImGui::WaterFall::FFTRedrawArgs> fftRedrawHandler;
     EventHandler<ImGui::WaterFall::InputHandlerArgs> inputHandler;
 
-    std::vector<SpotSource> spotSources;
+    // providers and spots, shared with every other instance
+    std::shared_ptr<SpotHub> hub;
+
+    // how this instance shows each source, by SpotSource::index
+    struct SourceView {
+        bool enabled;
+        ImU32 color;
+    };
+    std::vector<SourceView> views;
+    uint32_t shownSources = 0; // bits of SpotRecord::sources
+
+    // only touched from the UI thread
+    LabelLayout labelLayout = LabelLayout(&SpotsModule::labelTextWidth, this);
+    float labelTextHeight = 0;
+    LabelHitIndex waterfallLabels;
 
-    std::list<WaterfallSpot> waterfallSpots;
-    std::list<WaterfallLabel> waterfallLabels;
-    std::mutex waterfallMutex;
+    RenderStats renderStats;
 };
 
 MOD_EXPORT void _INIT_() {
@@ -1,81 +1,66 @@
 #ifndef __SDRPP_SPOTS_MAIN_H
 #define __SDRPP_SPOTS_MAIN_H
 
+#include <cstdint>
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <vector>
+#include "metrics.h"
 
-std::vector<std::string> split(const std::string &s, char delim) {
-    std::vector<std::string> result;
-    std::stringstream ss (s);
-    std::string item;
-
-    while (getline (ss, item, delim)) {
-        result.push_back (item);
+// split s on delim into at most maxParts views of s, without copying
+// anything past maxParts is left in the last part
+// returns the number of parts
+inline size_t splitFields(std::string_view s, char delim, std::string_view* parts, size_t maxParts) {
+    size_t count = 0;
+    while (count + 1 < maxParts) {
+        size_t loc = s.find(delim);
+        if (loc == s.npos) { break; }
+        parts[count++] = s.substr(0, loc);
+        s.remove_prefix(loc + 1);
     }
+    parts[count++] = s;
+    return count;
+}
 
-    return result;
+// the whole of s as a non-negative integer
+inline bool parseInt(std::string_view s, int* value) {
+    if (s.empty()) { return false; }
+    auto res = std::from_chars(s.data(), s.data() + s.size(), *value);
+    return res.ec == std::errc() && res.ptr == s.data() + s.size() && *value >= 0;
 }
 
-int parseTime(const std::string &s, std::chrono::time_point<std::chrono::system_clock>* t) {
-    std::tm tm{};
-    // HHMM YYYY-mm-dd
-    size_t loc = s.find(" ");
-    if(loc == s.npos || loc+1 >= s.size()) {
-        return 1;
-    }
-    std::string timeS = s.substr(0, loc);
-    int time = std::stoi(timeS);
-    if(time < 0) {
-        return 2;
-    }
-    tm.tm_sec = 0;
-    tm.tm_min = time % 100;
-    if(tm.tm_min >= 60) {
-        return 3;
-    }
-    tm.tm_hour = time / 100;
-    if(tm.tm_hour >= 24) {
-        return 4;
-    }
+// the whole of s as a plain non-negative decimal, like 14074.5
+// (floating point from_chars isn't everywhere yet)
+inline bool parseDecimal(std::string_view s, double* value) {
+    size_t dot = s.find('.');
+    std::string_view whole = s.substr(0, dot);
+    std::string_view fraction = dot == s.npos ? std::string_view() : s.substr(dot + 1);
+    if (whole.empty() && fraction.empty()) { return false; }
 
-    std::string dateS = s.substr(loc+1);
-    loc = dateS.find("-");
-    if(loc == s.npos || loc+1 >= dateS.size()) {
-        return 5;
-    }
-    std::string yearS = dateS.substr(0, loc);
-    int year = std::stoi(yearS);
-    if(year < 0) {
-        return 6;
-    }
-    dateS = dateS.substr(loc+1);
-    loc = dateS.find("-");
-    if(loc == s.npos || loc+1 >= dateS.size()) {
-        return 7;
-    }
-    std::string monthS = dateS.substr(0, loc);
-    int month = std::stoi(monthS);
-    if(month < 1 || month > 12) {
-        return 8;
+    double result = 0;
+    for (char c : whole) {
+        if (c < '0' || c > '9') { return false; }
+        result = result * 10 + (c - '0');
     }
-    std::string dayS = dateS.substr(loc+1);
-    int day = std::stoi(dayS);
-    if(day < 1 || day > 31) {
-        return 9;
+    double scale = 0.1;
+    for (char c : fraction) {
+        if (c < '0' || c > '9') { return false; }
+        result += (c - '0') * scale;
+        scale /= 10;
     }
+    *value = result;
+    return true;
+}
 
-    tm.tm_year = year - 1900;
-    tm.tm_mon = month-1; // Jan = 0
-    tm.tm_mday = day;
-    tm.tm_isdst = 0;
-
-    // from https://stackoverflow.com/a/38298359
-    std::time_t tLocal = std::mktime(&tm);
-    time_t tUTC = tLocal + (std::mktime(std::localtime(&tLocal)) - std::mktime(std::gmtime(&tLocal)));
-    *t = std::chrono::system_clock::from_time_t(tUTC);
-
-    return 0;
+// 64 bit FNV-1a, chain calls by passing the previous hash
+inline uint64_t fnv1a(const char* data, size_t len, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
 }
 
 struct Spot {
@@ -87,31 +72,44 @@ struct Spot {
     std::string location;
 };
 
-typedef void (*AddSpot)(Spot, void*, void*);
+// providers hand over a whole batch of spots at once, typically
+// everything from one poll. the receiver takes ownership of the spots
+typedef void (*AddSpots)(std::vector<Spot>&&, void*, void*);
 
 class SpotProvider {
 public:
     virtual ~SpotProvider() = 0;
-    virtual void start() = 0;
+    // false if it can't run as it's set up, it logs why
+    virtual bool start() = 0;
     virtual void stop() = 0;
 
-    void registerAddSpot(AddSpot a, void* sCtx, void* ctx) {
-        addSpotCallback = a;
-        addSpotSourceCtx = sCtx;
-        addSpotCtx = ctx;
+    void registerAddSpots(AddSpots a, void* sCtx, void* ctx) {
+        addSpotsCallback = a;
+        addSpotsSourceCtx = sCtx;
+        addSpotsCtx = ctx;
     }
-    void registerAddSpot(void* sCtx) {
+    void registerAddSpots(void* sCtx) {
         // useful to re-register the sCtx which might have moved
-        addSpotSourceCtx = sCtx;
+        addSpotsSourceCtx = sCtx;
     }
+
+    // safe to read from any thread while the provider runs
+    const ProviderStats& stats() const { return providerStats; }
+
 protected:
-    void addSpot(Spot spot) {
-        addSpotCallback(spot, addSpotSourceCtx, addSpotCtx);
+    void addSpots(std::vector<Spot>&& spots) {
+        if (spots.empty()) { return; }
+        addSpotsCallback(std::move(spots), addSpotsSourceCtx, addSpotsCtx);
     }
+
+    ProviderStats providerStats;
+
 private:
-    AddSpot addSpotCallback;
-    void* addSpotCtx;
-    void* addSpotSourceCtx;
+    AddSpots addSpotsCallback;
+    void* addSpotsCtx;
+    void* addSpotsSourceCtx;
 };
 
+inline SpotProvider::~SpotProvider() {}
+
 #endif //__SDRPP_SPOTS_MAIN_H
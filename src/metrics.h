@@ -0,0 +1,187 @@
+#ifndef __SDRPP_SPOTS_METRICS_H
+#define __SDRPP_SPOTS_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+/**********************************************
+ * A histogram of durations in seconds, with fixed buckets from 50us to
+ * 10s. Recording is a couple of relaxed atomic adds, so any thread can
+ * observe without locking and readers (the menu, the exporter) just see
+ * slightly stale totals.
+ **********************************************/
+class Histogram {
+public:
+    static constexpr size_t bucketCount = 17;
+    // upper bounds, everything bigger goes in the last (+Inf) bucket
+    static constexpr double bounds[bucketCount] = {
+        0.00005, 0.0001, 0.00025, 0.0005,
+        0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+        0.1, 0.25, 0.5, 1, 2.5, 5, 10
+    };
+
+    void observe(double seconds) {
+        size_t i = 0;
+        while (i < bucketCount && seconds > bounds[i]) { i++; }
+        buckets[i].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sumNanos.fetch_add((uint64_t)(seconds * 1e9), std::memory_order_relaxed);
+    }
+
+    void observeSince(std::chrono::steady_clock::time_point start) {
+        observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    double sum() const { return sumNanos.load(std::memory_order_relaxed) / 1e9; }
+    // not cumulative, i == bucketCount is +Inf
+    uint64_t bucket(size_t i) const { return buckets[i].load(std::memory_order_relaxed); }
+
+    // upper bound of the bucket the q quantile falls in, 0 if empty
+    double quantile(double q) const {
+        uint64_t n = count();
+        if (n == 0) { return 0; }
+        uint64_t rank = (uint64_t)(q * n);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; i++) {
+            seen += bucket(i);
+            if (seen > rank) { return bounds[i]; }
+        }
+        return bounds[bucketCount - 1];
+    }
+
+private:
+    std::atomic<uint64_t> buckets[bucketCount + 1] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sumNanos{0};
+};
+
+// running totals for one provider, whatever it fetches over
+// counters only ever go up, consecutiveFailures goes back to 0 on a
+// good fetch
+struct ProviderStats {
+    // a poll, or a connection attempt for streaming sources
+    std::atomic<uint64_t> fetches{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> consecutiveFailures{0};
+    Histogram fetchLatency;
+    // polled sources: milliseconds between polls, as adapted
+    std::atomic<uint64_t> pollInterval{0};
+
+    std::atomic<uint64_t> bytesReceived{0}; // on the wire, maybe compressed
+    std::atomic<uint64_t> bytesDecoded{0};
+    // http only: 304s, 200s with the same body as last time, and bytes
+    // we'd have downloaded without conditional requests or compression
+    std::atomic<uint64_t> notModified{0};
+    std::atomic<uint64_t> unchanged{0};
+    std::atomic<uint64_t> bytesSaved{0};
+
+    // time spent turning bytes into spots
+    Histogram parseTime;
+    // rows that became spots, rows skipped as already seen, rows that
+    // didn't decode and rows left out on purpose, like cluster chatter
+    std::atomic<uint64_t> rowsDecoded{0};
+    std::atomic<uint64_t> rowsSkipped{0};
+    std::atomic<uint64_t> rowsInvalid{0};
+    std::atomic<uint64_t> rowsFiltered{0};
+
+    void fetchSucceeded() {
+        fetches++;
+        consecutiveFailures = 0;
+    }
+    void fetchFailed() {
+        fetches++;
+        failures++;
+        consecutiveFailures++;
+    }
+};
+
+// one stage of the spot pipeline, fed by a queue
+struct StageStats {
+    std::atomic<uint64_t> items{0};  // processed
+    std::atomic<uint64_t> depth{0};  // waiting right now
+    std::atomic<uint64_t> stalls{0}; // times the queue in was full
+    Histogram queueWait;             // queued to picked up
+    Histogram processTime;
+};
+
+// what one module instance draws, written by the UI thread
+struct RenderStats {
+    Histogram redrawTime;
+    std::atomic<uint64_t> labelsVisible{0};
+    std::atomic<uint64_t> labelsLaidOut{0};
+    std::atomic<uint64_t> labelsDropped{0};
+};
+
+/**********************************************
+ * Builds metrics in the Prometheus text exposition format. Every sample
+ * of a metric has to follow its HELP/TYPE lines, so callers write one
+ * metric at a time across all their label sets.
+ **********************************************/
+class PrometheusWriter {
+public:
+    // a label pair for sample(), value escaped
+    static std::string label(const char* name, std::string_view value) {
+        std::string s = name;
+        s += "=\"";
+        for (char c : value) {
+            if (c == '\\' || c == '"') { s += '\\'; s += c; }
+            else if (c == '\n') { s += "\\n"; }
+            else { s += c; }
+        }
+        s += '"';
+        return s;
+    }
+
+    void metric(const char* name, const char* type, const char* help) {
+        text += "# HELP "; text += name; text += ' '; text += help; text += '\n';
+        text += "# TYPE "; text += name; text += ' '; text += type; text += '\n';
+    }
+
+    void sample(const char* name, const std::string& labels, double value, const char* suffix = "") {
+        char buf[64];
+        snprintf(buf, sizeof(buf), " %.9g\n", value);
+        text += name;
+        text += suffix;
+        if (!labels.empty()) { text += '{'; text += labels; text += '}'; }
+        text += buf;
+    }
+
+    void histogram(const char* name, const std::string& labels, const Histogram& h) {
+        std::string prefix = labels.empty() ? std::string() : labels + ",";
+        uint64_t cumulative = 0;
+        char le[32];
+        for (size_t i = 0; i < Histogram::bucketCount; i++) {
+            cumulative += h.bucket(i);
+            snprintf(le, sizeof(le), "le=\"%g\"", Histogram::bounds[i]);
+            sample(name, prefix + le, cumulative, "_bucket");
+        }
+        cumulative += h.bucket(Histogram::bucketCount);
+        sample(name, prefix + "le=\"+Inf\"", cumulative, "_bucket");
+        sample(name, labels, h.sum(), "_sum");
+        sample(name, labels, cumulative, "_count");
+    }
+
+    // replace path with what's been written so far, atomically so a
+    // scraper never reads half a file
+    bool writeFile(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        FILE* f = fopen(tmp.c_str(), "w");
+        if (!f) { return false; }
+        bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+        ok = fclose(f) == 0 && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::string text;
+};
+
+#endif //__SDRPP_SPOTS_METRICS_H
@@ -0,0 +1,345 @@
+#ifndef __SDRPP_SPOTS_DXCLUSTER_H
+#define __SDRPP_SPOTS_DXCLUSTER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <utils/flog.h>
+#include "../main.h"
+#include "../line_ring.h"
+#include "../spot_time.h"
+
+#ifndef MSG_NOSIGNAL
+// macOS, where SO_NOSIGPIPE does it instead
+#define MSG_NOSIGNAL 0
+#endif
+
+/**********************************************
+ * Live spots from a DX cluster node over telnet.
+ * Keeps one connection open on its own thread, logs in with our
+ * callsign when the node asks, and pushes each "DX de" line as a spot as
+ * soon as it arrives. Lost connections are retried with exponential
+ * backoff.
+ **********************************************/
+class DXClusterProvider : public SpotProvider {
+public:
+    DXClusterProvider() {}
+
+    virtual ~DXClusterProvider() {
+        stop();
+    }
+
+    // takes effect on the next (re)connect
+    void setServer(const std::string& host, int port, const std::string& callsign) {
+        std::lock_guard lk(mtx);
+        this->host = host;
+        this->port = port;
+        this->callsign = callsign;
+    }
+
+    bool start() {
+        std::lock_guard lk(mtx);
+        if (running) { return true; }
+        if (callsign.empty()) {
+            flog::error("dx cluster needs a callsign to log in with");
+            return false;
+        }
+        if (!openWakePipe()) {
+            flog::error("dx cluster could not create wake pipe: {0}", strerror(errno));
+            return false;
+        }
+        running = true;
+        flog::info("starting dx cluster {0}:{1}", host, port);
+        workerThread = std::thread(&DXClusterProvider::worker, this, host, port, callsign);
+        return true;
+    }
+
+    void stop() {
+        std::unique_lock lk(mtx);
+        if (!running) { return; }
+        running = false;
+        lk.unlock();
+
+        // wake up the worker wherever it's waiting
+        char c = 0;
+        if (write(wakePipe[1], &c, 1) < 0) {
+            flog::error("dx cluster could not wake worker: {0}", strerror(errno));
+        }
+        if (workerThread.joinable()) { workerThread.join(); }
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+    }
+
+    // DX de SPOTTER:   14025.0  DXCALL       comment            1234Z LOC
+    // the comment runs up to the time, the locator after it is optional
+    static bool parseSpotLine(std::string_view line, SpotTime now, Spot* spot) {
+        if (line.substr(0, 6) != "DX de ") { return false; }
+        line.remove_prefix(6);
+
+        size_t colon = line.find(':');
+        if (colon == line.npos || colon == 0) { return false; }
+        std::string_view spotter = line.substr(0, colon);
+        line.remove_prefix(colon + 1);
+
+        std::string_view freqText = nextToken(line);
+        double frequency;
+        if (!parseDecimal(freqText, &frequency) || frequency <= 0) { return false; }
+
+        std::string_view label = nextToken(line);
+        if (label.empty()) { return false; }
+
+        // last HHMMZ token is the time
+        size_t z = line.size();
+        SpotTime spotTime;
+        bool haveTime = false;
+        while (z > 0 && !haveTime) {
+            z = line.rfind('Z', z - 1);
+            if (z == line.npos) { break; }
+            int hhmm;
+            haveTime = z >= 4 && (z + 1 == line.size() || line[z + 1] == ' ') &&
+                (z == 4 || line[z - 5] == ' ') &&
+                parseInt(line.substr(z - 4, 4), &hhmm) && recentTime(hhmm, now, &spotTime);
+        }
+        if (!haveTime) { return false; }
+
+        spot->label.assign(label);
+        spot->spotter.assign(spotter);
+        spot->frequency = frequency * 1000;
+        spot->spotTime = spotTime;
+        spot->comment.assign(trim(line.substr(0, z - 4)));
+        spot->location.assign(trim(line.substr(z + 1)));
+        return true;
+    }
+
+    int connectTimeout = 10000; // milliseconds
+    int minBackoff = 1000;
+    int maxBackoff = 300000;
+
+private:
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) { s.remove_prefix(1); }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\a')) { s.remove_suffix(1); }
+        return s;
+    }
+
+    // next space separated token, consumed
+    static std::string_view nextToken(std::string_view& s) {
+        s = trim(s);
+        size_t end = std::min(s.find(' '), s.size());
+        std::string_view token = s.substr(0, end);
+        s.remove_prefix(end);
+        return token;
+    }
+
+    // the usual "login:" or "Please enter your call:" prompts, at the
+    // end of what the node sent so far. anything else that mentions a
+    // call is just cluster output
+    static bool isLoginPrompt(std::string_view s) {
+        static const std::string_view prompts[] = {"login:", "enter your call:", "enter your callsign:"};
+        while (!s.empty() && isspace((unsigned char)s.back())) { s.remove_suffix(1); }
+        std::string lower(s);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        std::string_view tail(lower);
+        for (std::string_view prompt : prompts) {
+            if (tail.size() >= prompt.size() && tail.substr(tail.size() - prompt.size()) == prompt) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // not inherited by anything SDR++ runs
+    bool openWakePipe() {
+#ifdef __linux__
+        return pipe2(wakePipe, O_CLOEXEC) == 0;
+#else
+        if (pipe(wakePipe) != 0) { return false; }
+        fcntl(wakePipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(wakePipe[1], F_SETFD, FD_CLOEXEC);
+        return true;
+#endif
+    }
+
+    void worker(std::string host, int port, std::string callsign) {
+        flog::info("dx cluster worker starting...");
+        int backoff = minBackoff;
+        while (isRunning()) {
+            auto connectedAt = std::chrono::steady_clock::now();
+            int fd = connectTo(host, port);
+            providerStats.fetchLatency.observeSince(connectedAt);
+            if (fd < 0) {
+                providerStats.fetchFailed();
+            } else {
+                providerStats.fetchSucceeded();
+                flog::info("connected to dx cluster {0}:{1}", host, port);
+                session(fd, callsign);
+                close(fd);
+                // a connection that stayed up a while was a good one
+                if (std::chrono::steady_clock::now() - connectedAt > std::chrono::minutes(1)) {
+                    backoff = minBackoff;
+                }
+            }
+            if (!isRunning()) { break; }
+            flog::info("reconnecting to dx cluster in {0} ms", backoff);
+            waitForWake(backoff);
+            backoff = std::min(backoff * 2, maxBackoff);
+        }
+        flog::info("dx cluster worker stopping.");
+    }
+
+    // non-blocking connect to the first address that answers
+    // returns the socket or -1
+    int connectTo(const std::string& host, int port) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addrs;
+        std::string service = std::to_string(port);
+        int err = getaddrinfo(host.c_str(), service.c_str(), &hints, &addrs);
+        if (err != 0) {
+            flog::error("could not resolve dx cluster {0}: {1}", host, gai_strerror(err));
+            return -1;
+        }
+
+        int fd = -1;
+        for (addrinfo* a = addrs; a && fd < 0 && isRunning(); a = a->ai_next) {
+            fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd < 0) { continue; }
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+            if (connect(fd, a->ai_addr, a->ai_addrlen) != 0 && errno != EINPROGRESS) {
+                close(fd);
+                fd = -1;
+                continue;
+            }
+            if (waitFor(fd, POLLOUT, connectTimeout) <= 0) {
+                close(fd);
+                fd = -1;
+                continue;
+            }
+            int soError = 0;
+            socklen_t len = sizeof(soError);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &soError, &len);
+            if (soError != 0) {
+                flog::error("could not connect to dx cluster {0}:{1}: {2}", host, port, strerror(soError));
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addrs);
+        return fd;
+    }
+
+    // read lines until the connection drops or we're stopped
+    void session(int fd, const std::string& callsign) {
+        lines.clear();
+        bool loggedIn = false;
+        std::vector<Spot> spots;
+        while (isRunning()) {
+            int ready = waitFor(fd, POLLIN, -1);
+            if (ready <= 0) { return; }
+
+            size_t space;
+            char* dst = lines.writable(&space);
+            ssize_t n = recv(fd, dst, space, 0);
+            if (n == 0) {
+                flog::info("dx cluster closed the connection");
+                return;
+            }
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) { continue; }
+                flog::error("error reading from dx cluster: {0}", strerror(errno));
+                return;
+            }
+            lines.commit(n);
+            providerStats.bytesReceived += n;
+
+            auto parseStart = std::chrono::steady_clock::now();
+            SpotTime now = SpotClock::now();
+            std::string_view line;
+            Spot spot;
+            while (lines.nextLine(&line)) {
+                if (parseSpotLine(line, now, &spot)) {
+                    spots.push_back(std::move(spot));
+                } else if (line.substr(0, 6) == "DX de ") {
+                    providerStats.rowsInvalid++;
+                } else if (!line.empty()) {
+                    // announcements, WWV and the like, not bad spots
+                    providerStats.rowsFiltered++;
+                }
+            }
+            providerStats.parseTime.observeSince(parseStart);
+            providerStats.rowsDecoded += spots.size();
+            // everything from this read goes over at once
+            addSpots(std::move(spots));
+            spots.clear();
+
+            // the prompt doesn't end in a newline
+            if (!loggedIn && isLoginPrompt(lines.partial())) {
+                std::string login = callsign + "\r\n";
+                if (send(fd, login.data(), login.size(), MSG_NOSIGNAL) != (ssize_t)login.size()) {
+                    flog::error("could not log in to dx cluster: {0}", strerror(errno));
+                    return;
+                }
+                flog::info("logged in to dx cluster as {0}", callsign);
+                loggedIn = true;
+                lines.clear();
+            }
+        }
+    }
+
+    // wait for events on fd, or for a stop
+    // returns > 0 if fd is ready, 0 on timeout, < 0 on error or stop
+    int waitFor(int fd, short events, int timeout) {
+        pollfd fds[2] = {{fd, events, 0}, {wakePipe[0], POLLIN, 0}};
+        int ready;
+        do {
+            ready = poll(fds, 2, timeout);
+        } while (ready < 0 && errno == EINTR);
+        if (ready < 0 || fds[1].revents) { return -1; }
+        if (ready == 0) { return 0; }
+        // errors and hangups are for the caller's connect/recv to report
+        return (fds[0].revents & POLLNVAL) ? -1 : 1;
+    }
+
+    void waitForWake(int timeout) {
+        pollfd wake = {wakePipe[0], POLLIN, 0};
+        poll(&wake, 1, timeout);
+    }
+
+    bool isRunning() {
+        std::lock_guard lk(mtx);
+        return running;
+    }
+
+    // only touched by the worker
+    LineRing lines;
+
+    std::string host = "dxc.ve7cc.net";
+    int port = 23;
+    std::string callsign;
+
+    // Threading
+    bool running = false;
+    int wakePipe[2] = {-1, -1};
+    std::thread workerThread;
+    std::mutex mtx;
+};
+
+#endif //__SDRPP_SPOTS_DXCLUSTER_H
@@ -1,7 +1,9 @@
 #ifndef __SDRPP_SPOTS_HAMQTH_H
 #define __SDRPP_SPOTS_HAMQTH_H
 
+#include <cstring>
 #include "http_poller.h"
+#include "../spot_time.h"
 
 class HamQTHProvider : public HTTPPoller {
 public:
@@ -10,51 +12,112 @@ public:
     }
 
 protected:
-    virtual void processResponse(std::string responseBody) {
-        std::vector<std::string> lines = split(responseBody, '\n');
-        for(const auto& line : lines) {
-            std::vector<std::string> parts = split(line, '^');
-            if(parts.size() < 6) {
-                flog::error("got invalid response line from hamqth (parts length) {0}", line);
-                break;
-            }
+    virtual void beginResponse() {
+        carry.clear();
+        badLine = false;
+    }
 
-            // frequency comes in kHz
-            double frequency = std::stod(parts[1]);
-            if(frequency <= 0) {
-                flog::error("got invalid response line from hamqth (frequency) {0}", line);
-                break;
+    // lines can be split across chunks, the start of one is carried over
+    // in carry until the rest of it arrives. whole lines are parsed right
+    // out of the chunk
+    virtual void processData(const char* data, size_t len) {
+        const char* end = data + len;
+        while (data < end) {
+            const char* newline = (const char*)memchr(data, '\n', end - data);
+            if (!newline) {
+                carry.append(data, end);
+                return;
             }
-            frequency *= 1000;
-
-            // time is HHMM YYYY-MM-DD
-            std::chrono::time_point<std::chrono::system_clock> spotTime;
-            if(parseTime(parts[4], &spotTime) != 0) {
-                flog::error("got invalid response line from hamqth (spot time) {0}", line);
-                break;
+            if (badLine) {
+                // only counted, the line it ends is never looked at
+                filterRow();
+                carry.clear();
+            } else if (carry.empty()) {
+                processLine(std::string_view(data, newline - data));
+            } else {
+                carry.append(data, newline);
+                processLine(carry);
+                carry.clear();
             }
+            data = newline + 1;
+        }
+    }
 
-            //everything is ok with input, we have a spot
-            //lastUpdate = std::chrono::system_clock::now();
-
-            std::string label = parts[2];
-            std::string spotter = parts[0];
-            std::string comment = parts[3];
-            std::string location = parts[9];
-
-            // the spot we'll insert into the list, even if it already
-            // exists
-            Spot spot = {
-                label,
-                spotter,
-                frequency,
-                spotTime,
-                comment,
-                location
-            };
-            addSpot(spot);
+    virtual void endResponse() {
+        // last line might not have a newline
+        if (carry.empty()) { return; }
+        if (badLine) {
+            filterRow();
+        } else {
+            processLine(carry);
         }
     }
+
+private:
+    enum LineError {
+        LINE_OK = 0,
+        LINE_FIELDS,
+        LINE_FREQUENCY,
+        LINE_TIME
+    };
+
+    void processLine(std::string_view line) {
+        uint64_t fingerprint = fnv1a(line.data(), line.size());
+        if (rows.seen(fingerprint)) {
+            // in the last response too, we already have it
+            return;
+        }
+        Spot spot;
+        LineError err = parseLine(line, &spot);
+        if (err != LINE_OK) {
+            const char* what = err == LINE_FIELDS ? "parts length" : err == LINE_FREQUENCY ? "frequency" : "spot time";
+            flog::error("got invalid response line from hamqth ({0}) {1}", what, std::string(line));
+            rejectRow();
+            badLine = true;
+            return;
+        }
+        rows.keep(fingerprint);
+        // the spot we'll hand over, even if it already exists
+        pushSpot(std::move(spot));
+    }
+
+    // call^kHz^dx^comment^HHMM YYYY-MM-DD^...^country^...
+    // only the fields the spot keeps are copied out of the line
+    static LineError parseLine(std::string_view line, Spot* spot) {
+        std::string_view parts[maxFields];
+        size_t count = splitFields(line, '^', parts, maxFields);
+        if(count < 6) {
+            return LINE_FIELDS;
+        }
+
+        // frequency comes in kHz
+        double frequency;
+        if(!parseDecimal(parts[1], &frequency) || frequency <= 0) {
+            return LINE_FREQUENCY;
+        }
+
+        // time is HHMM YYYY-MM-DD
+        if(parseTime(parts[4], &spot->spotTime) != 0) {
+            return LINE_TIME;
+        }
+
+        spot->frequency = frequency * 1000;
+        spot->label.assign(parts[2]);
+        spot->spotter.assign(parts[0]);
+        spot->comment.assign(parts[3]);
+        // location isn't always there
+        if (count > 9) {
+            spot->location.assign(parts[9]);
+        }
+        return LINE_OK;
+    }
+
+    static constexpr size_t maxFields = 12;
+
+    std::string carry;
+    // we stop at the first bad line, like we always have. the lines
+    // after it count as filtered
+    bool badLine = false;
 };
 
 #endif //__SDRPP_SPOTS_HAMQTH_H
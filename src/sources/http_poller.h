@@ -1,102 +1,145 @@
 #ifndef __SDRPP_SPOTS_HTTP_POLLER_H
 #define __SDRPP_SPOTS_HTTP_POLLER_H
 
-#include <thread>
-#include <mutex>
-#include <condition_variable>
+#include <cstdio>
 #include <chrono>
-#include <curl/curl.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "http_scheduler.h"
+#include "row_filter.h"
 #include "../main.h"
 
+// a source that's polled over HTTP
+// subclasses just provide the url and decode the response as it streams
+// in, the polling itself happens on the shared HTTPScheduler thread and
+// the decoding on its decode pool
 class HTTPPoller : public SpotProvider {
 public:
     HTTPPoller() {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
+        spec.url = url;
+        spec.onBegin = &HTTPPoller::onBegin;
+        spec.onData = &HTTPPoller::onData;
+        spec.onEnd = &HTTPPoller::onEnd;
+        spec.ctx = this;
+        spec.stats = &providerStats;
     }
 
     virtual ~HTTPPoller() {
-        curl_global_cleanup();
+        // owners should stop us first, the decoding hooks are gone by now
+        stop();
     }
 
-    void start() {
-        std::unique_lock cv_lk(mtx);
-        if (running) { return; }
-
-        // join old thread if it killed itself
-        if (workerThread.joinable()) { workerThread.join(); }
+    bool start() {
+        std::lock_guard lk(mtx);
+        if (running) { return true; }
         running = true;
-        flog::info("starting worker thread");
-        workerThread = std::thread(&HTTPPoller::worker, this);
+        // spots from before are gone from the store, so send every row
+        rows.reset();
+        spec.pollPeriod = pollPeriod;
+        flog::info("starting polling {0}", url);
+        HTTPScheduler::instance().add(&spec);
+        return true;
     }
 
     void stop() {
-        std::unique_lock cv_lk(mtx);
+        std::lock_guard lk(mtx);
         if (!running) { return; }
-
-        // let worker know we're shutting down
-        cv_lk.unlock();
-        cv.notify_all();
+        HTTPScheduler::instance().remove(&spec);
         running = false;
-        if (workerThread.joinable()) { workerThread.join(); }
+    }
+
+    // point the source somewhere else, like a local stand-in. only while
+    // stopped, takes effect on the next start
+    void setUrl(const std::string& url) {
+        std::lock_guard lk(mtx);
+        snprintf(this->url, sizeof(this->url), "%s", url.c_str());
+    }
+
+    // milliseconds between polls, takes effect on the next start
+    void setPollPeriod(int period) {
+        std::lock_guard lk(mtx);
+        pollPeriod = period;
+    }
+
+    // run a whole response body through the decoder as if it had just
+    // been polled, without any network. for benchmarks
+    void decode(const char* data, size_t len) {
+        onBegin(this);
+        onData(data, len, this);
+        onEnd(true, this);
     }
 
 protected:
-    virtual void processResponse(std::string response) = 0;
+    // a new response, drop any state left from the last one
+    virtual void beginResponse() = 0;
+    // the next chunk of the body, chunks split anywhere
+    virtual void processData(const char* data, size_t len) = 0;
+    // the whole body is in, only called for responses we keep
+    virtual void endResponse() = 0;
+
+    // add a decoded spot to the batch handed over at the end of the
+    // response
+    void pushSpot(Spot&& spot) { pending.push_back(std::move(spot)); }
+    // a new row that didn't decode, and one left out on purpose
+    void rejectRow() { rejected++; }
+    void filterRow() { filtered++; }
+
+    // subclasses check each raw row here before decoding it
+    RowFilter rows;
+
     char url[1024];
+    int pollPeriod = 15000;
 
 private:
+    static void onBegin(void* ctx) {
+        HTTPPoller* _this = (HTTPPoller*)ctx;
+        _this->pending.clear();
+        _this->rejected = 0;
+        _this->filtered = 0;
+        _this->parseElapsed = std::chrono::steady_clock::duration::zero();
+        _this->rows.begin();
+        _this->beginResponse();
+    }
 
-    void worker() {
-        flog::info("worker starting...");
-        std::unique_lock cv_lk(mtx);
-        while (running) {
-            std::string responseBody = "";
-            long responseCode;
-
-            CURL* curl = curl_easy_init();
-            if (!curl) {
-                flog::error("could not get a curl handle");
-                break;
-            }
-            curl_easy_setopt(curl, CURLOPT_URL, url);
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, readResponse);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseBody);
-            CURLcode res = curl_easy_perform(curl);
-
-            if (res != CURLE_OK) {
-                curl_easy_cleanup(curl);
-                flog::error("error making request {0}", url);
-                break;
-            }
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
-            if (responseCode != 200) {
-                curl_easy_cleanup(curl);
-                flog::error("got error: {0}", responseCode);
-                break;
-            }
-
-            curl_easy_cleanup(curl);
-
-            processResponse(responseBody);
-
-            cv.wait_for(cv_lk, std::chrono::milliseconds(pollPeriod));
-        }
-        flog::info("worker stopping.");
+    static void onData(const char* data, size_t len, void* ctx) {
+        HTTPPoller* _this = (HTTPPoller*)ctx;
+        auto start = std::chrono::steady_clock::now();
+        _this->processData(data, len);
+        _this->parseElapsed += std::chrono::steady_clock::now() - start;
     }
 
-    static size_t readResponse(void *contents, size_t size, size_t nmemb, void* ctx) {
-        std::string* responseBody = (std::string*) ctx;
-        responseBody->append((char*) contents, (char*)contents + size*nmemb);
-        return size*nmemb;
+    static size_t onEnd(bool keep, void* ctx) {
+        HTTPPoller* _this = (HTTPPoller*)ctx;
+        size_t added = 0;
+        if (keep) {
+            auto start = std::chrono::steady_clock::now();
+            _this->endResponse();
+            _this->rows.commit();
+            _this->parseElapsed += std::chrono::steady_clock::now() - start;
+
+            // parsing is spread over the chunks, time it as one
+            ProviderStats& stats = _this->providerStats;
+            stats.parseTime.observe(std::chrono::duration<double>(_this->parseElapsed).count());
+            stats.rowsDecoded += _this->pending.size();
+            stats.rowsSkipped += _this->rows.skipped;
+            stats.rowsInvalid += _this->rejected;
+            stats.rowsFiltered += _this->filtered;
+            flog::debug("{0}: {1} new rows, {2} already seen", _this->url, _this->rows.fresh, _this->rows.skipped);
+            added = _this->pending.size();
+            _this->addSpots(std::move(_this->pending));
+        }
+        _this->pending.clear();
+        return added;
     }
 
-    // Threading
-    int pollPeriod = 15000;
+    PollSpec spec;
+    std::vector<Spot> pending;
+    size_t rejected = 0;
+    size_t filtered = 0;
+    std::chrono::steady_clock::duration parseElapsed;
     bool running = false;
-    std::thread workerThread;
-    std::condition_variable cv;
     std::mutex mtx;
 };
 
 #endif //__SDRPP_SPOTS_HTTP_POLLER_H
-
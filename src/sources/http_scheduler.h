@@ -0,0 +1,721 @@
+#ifndef __SDRPP_SPOTS_HTTP_SCHEDULER_H
+#define __SDRPP_SPOTS_HTTP_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cctype>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <cmath>
+#include <random>
+#include <curl/curl.h>
+#include <utils/flog.h>
+#include "../main.h"
+#include "../bounded_queue.h"
+
+// a successful response is starting
+typedef void (*PollBegin)(void*);
+// the next chunk of the body, as it comes off the wire
+typedef void (*PollData)(const char*, size_t, void*);
+// the body is done, keep is false if the transfer failed or the body was
+// the same as last time. returns how many new rows it brought
+typedef size_t (*PollEnd)(bool, void*);
+
+// what to poll and what to do with the response
+struct PollSpec {
+    const char* url;
+    int pollPeriod; // milliseconds, the scheduler adapts around this
+    PollBegin onBegin;
+    PollData onData;
+    PollEnd onEnd;
+    void* ctx;
+    ProviderStats* stats;
+};
+
+/**********************************************
+ * One thread polls every HTTP source through a single curl_multi handle.
+ * Each source keeps its own easy handle between polls, and the multi
+ * handle keeps a connection cache, so connections and TLS sessions get
+ * reused from poll to poll. Adding a source doesn't add a thread.
+ *
+ * Polls are conditional (If-None-Match/If-Modified-Since) and ask for a
+ * compressed response. A 304 never reaches the source, a body that
+ * hashes the same as the last one ends with onEnd(false) so the source
+ * throws away what it decoded.
+ *
+ * How often each source is polled adapts to how often it changes: the
+ * interval shrinks after a poll whose onEnd reported new rows and grows
+ * after one that didn't, between fastestPoll and slowestPoll times the
+ * spec's pollPeriod. Failures back off exponentially from pollPeriod up
+ * to maxBackoff and never stop the polling, a Retry-After from the
+ * server pushes the next poll out at least that far. Every delay gets
+ * some jitter so sources drift apart instead of firing together.
+ *
+ * Fetching and decoding are separate stages. The scheduler thread only
+ * does network I/O: it cuts each body into chunkSize chunks as it comes
+ * in and queues them for a small pool of decode threads, which run the
+ * spec's onBegin/onData/onEnd on them while the rest downloads. Each job
+ * sticks to one decoder, so its chunks are decoded in order and its
+ * callbacks never run concurrently. Chunk buffers are pooled, and when
+ * a job's decoder falls maxBacklog chunks behind its transfer is paused,
+ * so a response costs a bounded number of chunks however big it is.
+ *
+ * A job isn't polled again until its last response is decoded, so a
+ * slow source backs off by itself. onEnd is where sources hand spots
+ * on, so a full merge queue downstream holds the decoders back in turn.
+ * Every onBegin is followed by exactly one onEnd. Once remove() returns
+ * the scheduler won't touch that spec again.
+ **********************************************/
+class HTTPScheduler {
+public:
+    static HTTPScheduler& instance() {
+        static HTTPScheduler scheduler;
+        return scheduler;
+    }
+
+    ~HTTPScheduler() {
+        stopWorker();
+        for (auto& job : jobs) {
+            cleanupJob(*job);
+        }
+        curl_multi_cleanup(multi);
+        curl_global_cleanup();
+    }
+
+    // start polling, the first poll happens right away
+    void add(PollSpec* spec) {
+        std::unique_lock lk(mtx);
+        if (std::find(pendingAdds.begin(), pendingAdds.end(), spec) != pendingAdds.end() || findJob(spec) != jobs.end()) {
+            return;
+        }
+        pendingAdds.push_back(spec);
+        if (!running) {
+            // join old thread if it stopped after the last source left
+            lk.unlock();
+            if (workerThread.joinable()) { workerThread.join(); }
+            lk.lock();
+            running = true;
+            flog::info("starting http scheduler");
+            startDecoders();
+            workerThread = std::thread(&HTTPScheduler::worker, this);
+        } else {
+            curl_multi_wakeup(multi);
+        }
+    }
+
+    // stop polling, waits for any response being fetched or decoded
+    void remove(PollSpec* spec) {
+        std::unique_lock lk(mtx);
+        auto pending = std::find(pendingAdds.begin(), pendingAdds.end(), spec);
+        if (pending != pendingAdds.end()) {
+            pendingAdds.erase(pending);
+        } else if (findJob(spec) != jobs.end()) {
+            pendingRemoves.push_back(spec);
+            curl_multi_wakeup(multi);
+            cv.wait(lk, [this, spec]() { return findJob(spec) == jobs.end(); });
+        }
+
+        if (jobs.empty() && pendingAdds.empty() && running) {
+            // nothing left to poll
+            lk.unlock();
+            stopWorker();
+        }
+    }
+
+    // transfers (depth is how many are in flight, queue wait how late
+    // they started) and decoding
+    const StageStats& fetchStats() const { return fetchStage; }
+    const StageStats& decodeStats() const { return decodeStage; }
+
+private:
+    enum Result { FAILED, UNCHANGED, CHANGED };
+
+    struct Job;
+
+    // one step of decoding a response, for the job's decoder
+    struct DecodeTask {
+        enum Kind { BEGIN, DATA, END };
+        Job* job = NULL;
+        Kind kind = DATA;
+        std::unique_ptr<char[]> data; // chunkSize, from the buffer pool
+        size_t len = 0;
+        bool keep = false;            // for END
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    struct Job {
+        HTTPScheduler* scheduler;
+        PollSpec* spec;
+        CURL* curl = NULL;
+        curl_slist* requestHeaders = NULL;
+        bool inFlight = false;
+        size_t decoder = 0; // index in decodeQueues
+        // a response is queued for or being decoded, set by the scheduler
+        // thread and cleared by the decoder after onEnd
+        std::atomic<bool> decoding{false};
+        size_t newRows = 0; // what onEnd reported, set before decoding is cleared
+
+        // only touched by the scheduler thread
+        bool begun = false;                 // sent BEGIN for the response in flight
+        std::unique_ptr<char[]> fill;       // chunk being filled
+        size_t fillLen = 0;
+        std::deque<DecodeTask> backlog;     // no room on the decoder's queue yet
+        bool paused = false;                // transfer paused on the backlog
+        // next poll is set once the decoder says if the response had
+        // anything new
+        bool awaitingRows = false;
+        int64_t pendingRetryAfter = 0;
+
+        uint64_t responseHash = 0;
+        size_t responseSize = 0;
+        std::chrono::steady_clock::time_point nextPoll;
+        double interval = 0; // milliseconds, adapted
+        int failures = 0;    // in a row
+        std::string responseRetryAfter;
+
+        // validators from the last response we processed, and from the
+        // one in flight
+        std::string etag;
+        std::string lastModified;
+        std::string responseEtag;
+        std::string responseLastModified;
+        uint64_t bodyHash = 0;
+        size_t lastBodySize = 0;
+    };
+
+    HTTPScheduler() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        multi = curl_multi_init();
+    }
+
+    void stopWorker() {
+        std::unique_lock lk(mtx);
+        running = false;
+        curl_multi_wakeup(multi);
+        lk.unlock();
+        if (workerThread.joinable()) { workerThread.join(); }
+        stopDecoders();
+    }
+
+    // with mtx held
+    void startDecoders() {
+        int count = std::clamp<int>(std::thread::hardware_concurrency() / 2, 1, maxDecoders);
+        decodeQueues.clear();
+        for (int i = 0; i < count; i++) {
+            decodeQueues.push_back(std::make_unique<BoundedQueue<DecodeTask>>(decodeQueueSize));
+        }
+        for (int i = 0; i < count; i++) {
+            decodeThreads.emplace_back(&HTTPScheduler::decodeWorker, this, i);
+        }
+    }
+
+    void stopDecoders() {
+        // they finish what's queued first
+        for (auto& queue : decodeQueues) {
+            queue->close();
+        }
+        for (auto& t : decodeThreads) {
+            if (t.joinable()) { t.join(); }
+        }
+        decodeThreads.clear();
+    }
+
+    std::vector<std::unique_ptr<Job>>::iterator findJob(PollSpec* spec) {
+        return std::find_if(jobs.begin(), jobs.end(), [spec](const std::unique_ptr<Job>& j) { return j->spec == spec; });
+    }
+
+    void worker() {
+        flog::info("http scheduler starting...");
+        std::unique_lock lk(mtx);
+        while (running) {
+            applyPending();
+            lk.unlock();
+
+            auto now = std::chrono::steady_clock::now();
+            flushBacklogs();
+            startDue(now);
+
+            int stillRunning = 0;
+            curl_multi_perform(multi, &stillRunning);
+            int msgsLeft = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &msgsLeft)) {
+                if (msg->msg == CURLMSG_DONE) {
+                    finish(msg);
+                }
+            }
+
+            // sleep until the next poll is due or curl has something to do
+            auto nextPoll = now + std::chrono::seconds(1);
+            for (auto& job : jobs) {
+                if (!job->inFlight && !job->decoding) { nextPoll = std::min(nextPoll, job->nextPoll); }
+                if (!job->backlog.empty()) {
+                    // decoders are backed up, try again soon
+                    nextPoll = std::min(nextPoll, now + std::chrono::milliseconds(10));
+                }
+            }
+            int timeout = std::max<int>(0, std::chrono::duration_cast<std::chrono::milliseconds>(nextPoll - std::chrono::steady_clock::now()).count());
+            curl_multi_poll(multi, NULL, 0, timeout, NULL);
+
+            lk.lock();
+        }
+        flog::info("http scheduler stopping.");
+    }
+
+    // with mtx held
+    void applyPending() {
+        for (PollSpec* spec : pendingAdds) {
+            auto job = std::make_unique<Job>();
+            job->scheduler = this;
+            job->spec = spec;
+            job->decoder = nextDecoder++ % decodeQueues.size();
+            job->nextPoll = std::chrono::steady_clock::now();
+            job->interval = spec->pollPeriod;
+            jobs.push_back(std::move(job));
+        }
+        pendingAdds.clear();
+
+        if (pendingRemoves.empty()) { return; }
+        bool removed = false;
+        for (auto it = pendingRemoves.begin(); it != pendingRemoves.end();) {
+            auto job = findJob(*it);
+            if (job != jobs.end()) {
+                abortTransfer(**job);
+            }
+            if (job != jobs.end() && ((*job)->decoding || !(*job)->backlog.empty())) {
+                // the decoder wakes us when it's done with it
+                ++it;
+                continue;
+            }
+            if (job != jobs.end()) {
+                cleanupJob(**job);
+                jobs.erase(job);
+            }
+            it = pendingRemoves.erase(it);
+            removed = true;
+        }
+        if (removed) { cv.notify_all(); }
+    }
+
+    // hand chunks the decoders had no room for before to them again, and
+    // resume transfers that were waiting on that
+    void flushBacklogs() {
+        for (auto& job : jobs) {
+            BoundedQueue<DecodeTask>& queue = *decodeQueues[job->decoder];
+            if (!job->backlog.empty()) {
+                while (!job->backlog.empty() && queue.tryPush(std::move(job->backlog.front()))) {
+                    job->backlog.pop_front();
+                }
+                if (job->backlog.empty()) { backlogged--; }
+            }
+            if (job->paused && job->backlog.size() < maxBacklog) {
+                job->paused = false;
+                // curl may hand the held back data over right here
+                curl_easy_pause(job->curl, CURLPAUSE_CONT);
+            }
+        }
+    }
+
+    // never blocks the network, chunks the decoder has no room for wait
+    // in the job's backlog
+    void queueDecode(Job& job, DecodeTask&& task) {
+        task.job = &job;
+        task.queued = std::chrono::steady_clock::now();
+        decodeStage.depth++;
+        if (!job.backlog.empty() || !decodeQueues[job.decoder]->tryPush(std::move(task))) {
+            decodeStage.stalls++;
+            if (job.backlog.empty()) { backlogged++; }
+            job.backlog.push_back(std::move(task));
+        }
+    }
+
+    void queueFill(Job& job) {
+        if (!job.fill) { return; }
+        if (job.fillLen == 0) {
+            putBuffer(std::move(job.fill));
+            return;
+        }
+        DecodeTask task;
+        task.kind = DecodeTask::DATA;
+        task.data = std::move(job.fill);
+        task.len = job.fillLen;
+        job.fillLen = 0;
+        queueDecode(job, std::move(task));
+    }
+
+    // the response in flight is done with, keep says if the source should
+    // use what it decoded
+    void endDecode(Job& job, bool keep) {
+        if (!job.begun) { return; }
+        queueFill(job);
+        DecodeTask task;
+        task.kind = DecodeTask::END;
+        task.keep = keep;
+        queueDecode(job, std::move(task));
+        job.begun = false;
+    }
+
+    // stop the job's transfer, if there is one, for good
+    void abortTransfer(Job& job) {
+        if (job.inFlight) {
+            curl_multi_remove_handle(multi, job.curl);
+            job.inFlight = false;
+            job.paused = false;
+            fetchStage.depth--;
+        }
+        endDecode(job, false);
+    }
+
+    void decodeWorker(int index) {
+        BoundedQueue<DecodeTask>& queue = *decodeQueues[index];
+        DecodeTask task;
+        while (queue.pop(task)) {
+            decodeStage.depth--;
+            decodeStage.queueWait.observeSince(task.queued);
+            auto start = std::chrono::steady_clock::now();
+
+            Job* job = task.job;
+            PollSpec* spec = job->spec;
+            if (task.kind == DecodeTask::BEGIN) {
+                spec->onBegin(spec->ctx);
+            } else if (task.kind == DecodeTask::DATA) {
+                spec->onData(task.data.get(), task.len, spec->ctx);
+                putBuffer(std::move(task.data));
+                // there's room for the chunks waiting on us now
+                if (backlogged) { curl_multi_wakeup(multi); }
+            } else {
+                job->newRows = spec->onEnd(task.keep, spec->ctx);
+            }
+
+            decodeStage.processTime.observeSince(start);
+            decodeStage.items++;
+            if (task.kind == DecodeTask::END) {
+                job->decoding = false;
+                // due for polling again, or waiting to be removed
+                curl_multi_wakeup(multi);
+            }
+        }
+    }
+
+    std::unique_ptr<char[]> getBuffer() {
+        std::lock_guard lk(bufferMtx);
+        if (freeBuffers.empty()) {
+            return std::unique_ptr<char[]>(new char[chunkSize]);
+        }
+        std::unique_ptr<char[]> buffer = std::move(freeBuffers.back());
+        freeBuffers.pop_back();
+        return buffer;
+    }
+
+    void putBuffer(std::unique_ptr<char[]>&& buffer) {
+        std::lock_guard lk(bufferMtx);
+        if (freeBuffers.size() < maxFreeBuffers) {
+            freeBuffers.push_back(std::move(buffer));
+        }
+    }
+
+    void startDue(std::chrono::steady_clock::time_point now) {
+        for (auto& job : jobs) {
+            if (job->awaitingRows && !job->decoding) {
+                job->awaitingRows = false;
+                schedule(*job, job->newRows ? CHANGED : UNCHANGED, job->pendingRetryAfter);
+            }
+            if (job->inFlight || job->decoding || job->nextPoll > now) { continue; }
+
+            if (!job->curl) {
+                // kept for the life of the job so the connection is reused
+                job->curl = curl_easy_init();
+                if (!job->curl) {
+                    flog::error("could not get a curl handle");
+                    schedule(*job, FAILED, 0);
+                    continue;
+                }
+                curl_easy_setopt(job->curl, CURLOPT_WRITEFUNCTION, readResponse);
+                curl_easy_setopt(job->curl, CURLOPT_WRITEDATA, job.get());
+                curl_easy_setopt(job->curl, CURLOPT_HEADERFUNCTION, readHeader);
+                curl_easy_setopt(job->curl, CURLOPT_HEADERDATA, job.get());
+                // empty means every encoding this libcurl can decode
+                curl_easy_setopt(job->curl, CURLOPT_ACCEPT_ENCODING, "");
+                curl_easy_setopt(job->curl, CURLOPT_PRIVATE, job.get());
+                curl_easy_setopt(job->curl, CURLOPT_TIMEOUT_MS, (long)requestTimeout);
+                curl_easy_setopt(job->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+            }
+            curl_easy_setopt(job->curl, CURLOPT_URL, job->spec->url);
+
+            curl_slist_free_all(job->requestHeaders);
+            job->requestHeaders = NULL;
+            if (!job->etag.empty()) {
+                job->requestHeaders = curl_slist_append(job->requestHeaders, ("If-None-Match: " + job->etag).c_str());
+            }
+            if (!job->lastModified.empty()) {
+                job->requestHeaders = curl_slist_append(job->requestHeaders, ("If-Modified-Since: " + job->lastModified).c_str());
+            }
+            curl_easy_setopt(job->curl, CURLOPT_HTTPHEADER, job->requestHeaders);
+
+            job->begun = false;
+            job->responseHash = fnv1a(NULL, 0);
+            job->responseSize = 0;
+            job->responseEtag.clear();
+            job->responseLastModified.clear();
+            job->responseRetryAfter.clear();
+            job->inFlight = true;
+            fetchStage.depth++;
+            fetchStage.queueWait.observe(std::chrono::duration<double>(now - job->nextPoll).count());
+            curl_multi_add_handle(multi, job->curl);
+        }
+    }
+
+    void finish(CURLMsg* msg) {
+        Job* job;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&job);
+        CURLcode res = msg->data.result;
+        curl_multi_remove_handle(multi, job->curl);
+        job->inFlight = false;
+
+        double latency = 0;
+        curl_easy_getinfo(job->curl, CURLINFO_TOTAL_TIME, &latency);
+        job->spec->stats->fetchLatency.observe(latency);
+        fetchStage.depth--;
+        fetchStage.items++;
+        fetchStage.processTime.observe(latency);
+        Result result = FAILED;
+        if (res == CURLE_OK) {
+            result = checkResponse(job);
+        } else {
+            flog::error("could not poll {0}: {1}", job->spec->url, curl_easy_strerror(res));
+            job->spec->stats->fetchFailed();
+        }
+        if (result == CHANGED) {
+            // whether the poll brought anything new is up to the decoder
+            job->awaitingRows = true;
+            job->pendingRetryAfter = retryAfter(job->responseRetryAfter);
+        } else {
+            schedule(*job, result, retryAfter(job->responseRetryAfter));
+        }
+        endDecode(*job, result == CHANGED);
+    }
+
+    // sets nextPoll after a poll with the given result
+    // retryAfter is what the server asked for in milliseconds, or 0
+    void schedule(Job& job, Result result, int64_t retryAfter) {
+        double base = job.spec->pollPeriod;
+        double delay;
+        if (result == FAILED) {
+            job.failures++;
+            // pollPeriod, doubling with each failure in a row
+            delay = std::min<double>(maxBackoff, base * std::pow(2.0, std::min(job.failures - 1, 16)));
+            flog::warn("{0} failed {1} times in a row, retrying in {2} s", job.spec->url, job.failures, (int)(std::max<double>(delay, retryAfter) / 1000));
+        } else {
+            if (job.failures > 0) {
+                flog::info("{0} recovered after {1} failures", job.spec->url, job.failures);
+            }
+            job.failures = 0;
+            // busy feeds get polled more often, quiet ones less
+            job.interval *= result == CHANGED ? speedUp : slowDown;
+            job.interval = std::clamp(job.interval, base * fastestPoll, base * slowestPoll);
+            delay = job.interval;
+        }
+        job.spec->stats->pollInterval = (uint64_t)job.interval;
+
+        std::uniform_real_distribution<double> spread(1 - jitter, 1 + jitter);
+        delay *= spread(rng);
+        delay = std::max<double>(delay, std::min<int64_t>(retryAfter, maxRetryAfter));
+        job.nextPoll = std::chrono::steady_clock::now() + std::chrono::milliseconds((int64_t)delay);
+    }
+
+    // a Retry-After header value, delay-seconds or an HTTP date, in
+    // milliseconds from now. 0 if there's none or it doesn't parse
+    static int64_t retryAfter(const std::string& value) {
+        if (value.empty()) { return 0; }
+        int seconds;
+        if (parseInt(value, &seconds)) {
+            return (int64_t)seconds * 1000;
+        }
+        time_t when = curl_getdate(value.c_str(), NULL);
+        if (when < 0) { return 0; }
+        return std::max<int64_t>(0, ((int64_t)when - (int64_t)time(NULL)) * 1000);
+    }
+
+    // after a transfer, updates stats and validators
+    // returns CHANGED if the body is worth keeping, the body hash only
+    // tells us to throw the decoded rows away
+    Result checkResponse(Job* job) {
+        ProviderStats& stats = *job->spec->stats;
+        long responseCode;
+        curl_easy_getinfo(job->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+        if (responseCode == 304) {
+            stats.fetchSucceeded();
+            stats.notModified++;
+            stats.bytesSaved += job->lastBodySize;
+            flog::debug("{0} not modified", job->spec->url);
+            return UNCHANGED;
+        }
+        if (responseCode != 200) {
+            flog::error("got error: {0} from {1}", responseCode, job->spec->url);
+            stats.fetchFailed();
+            return FAILED;
+        }
+        stats.fetchSucceeded();
+
+        curl_off_t received = 0;
+        curl_easy_getinfo(job->curl, CURLINFO_SIZE_DOWNLOAD_T, &received);
+        size_t decoded = job->responseSize;
+        stats.bytesReceived += received;
+        stats.bytesDecoded += decoded;
+        if (decoded > (size_t)received) {
+            stats.bytesSaved += decoded - received;
+        }
+
+        job->etag = std::move(job->responseEtag);
+        job->lastModified = std::move(job->responseLastModified);
+        job->lastBodySize = decoded;
+
+        if (job->responseHash == job->bodyHash) {
+            // server doesn't do conditional requests, but nothing changed.
+            // the source throws away what it decoded
+            stats.unchanged++;
+            flog::debug("{0} unchanged", job->spec->url);
+            return UNCHANGED;
+        }
+        job->bodyHash = job->responseHash;
+        return CHANGED;
+    }
+
+    void cleanupJob(Job& job) {
+        if (!job.curl) { return; }
+        abortTransfer(job);
+        curl_easy_cleanup(job.curl);
+        job.curl = NULL;
+        curl_slist_free_all(job.requestHeaders);
+        job.requestHeaders = NULL;
+    }
+
+    static size_t readResponse(void *contents, size_t size, size_t nmemb, void* ctx) {
+        Job* job = (Job*) ctx;
+        return job->scheduler->collect(*job, (const char*) contents, size*nmemb);
+    }
+
+    // hashes the body and cuts it into chunks for the decoder as it comes
+    // in, only 200s get decoded
+    size_t collect(Job& job, const char* data, size_t len) {
+        if (job.responseSize == 0 && !job.begun) {
+            // headers are all in by the first chunk of the body
+            long responseCode = 0;
+            curl_easy_getinfo(job.curl, CURLINFO_RESPONSE_CODE, &responseCode);
+            if (responseCode == 200) {
+                job.begun = true;
+                job.decoding = true;
+                DecodeTask task;
+                task.kind = DecodeTask::BEGIN;
+                queueDecode(job, std::move(task));
+            }
+        }
+        if (job.begun && job.backlog.size() >= maxBacklog) {
+            // curl hands this over again once flushBacklogs() resumes us
+            job.paused = true;
+            return CURL_WRITEFUNC_PAUSE;
+        }
+        job.responseHash = fnv1a(data, len, job.responseHash);
+        job.responseSize += len;
+        if (!job.begun) { return len; }
+
+        for (size_t done = 0; done < len;) {
+            if (!job.fill) {
+                job.fill = getBuffer();
+                job.fillLen = 0;
+            }
+            size_t n = std::min(chunkSize - job.fillLen, len - done);
+            memcpy(job.fill.get() + job.fillLen, data + done, n);
+            job.fillLen += n;
+            done += n;
+            if (job.fillLen == chunkSize) {
+                queueFill(job);
+            }
+        }
+        return len;
+    }
+
+    // header names are case insensitive
+    static bool headerIs(const char* buffer, size_t len, const char* name, size_t nameLen) {
+        if (len < nameLen) { return false; }
+        for (size_t i = 0; i < nameLen; i++) {
+            if (std::tolower((unsigned char)buffer[i]) != std::tolower((unsigned char)name[i])) { return false; }
+        }
+        return true;
+    }
+
+    // keep the validators we need for the next conditional request
+    static size_t readHeader(char* buffer, size_t size, size_t nitems, void* ctx) {
+        Job* job = (Job*) ctx;
+        size_t len = size * nitems;
+        std::string* value = NULL;
+        size_t nameLen;
+        if (headerIs(buffer, len, "ETag:", 5)) {
+            value = &job->responseEtag;
+            nameLen = 5;
+        } else if (headerIs(buffer, len, "Last-Modified:", 14)) {
+            value = &job->responseLastModified;
+            nameLen = 14;
+        } else if (headerIs(buffer, len, "Retry-After:", 12)) {
+            value = &job->responseRetryAfter;
+            nameLen = 12;
+        }
+        if (value) {
+            size_t start = nameLen;
+            size_t end = len;
+            while (start < end && (buffer[start] == ' ' || buffer[start] == '\t')) { start++; }
+            while (end > start && (buffer[end-1] == '\r' || buffer[end-1] == '\n' || buffer[end-1] == ' ')) { end--; }
+            value->assign(buffer + start, end - start);
+        }
+        return len;
+    }
+
+    int requestTimeout = 30000;
+    // adaptive interval bounds, as multiples of pollPeriod, and how much
+    // one poll moves it
+    double fastestPoll = 0.5;
+    double slowestPoll = 4;
+    double speedUp = 0.8;
+    double slowDown = 1.25;
+    double jitter = 0.1; // +/- this fraction of every delay
+    int maxBackoff = 10 * 60 * 1000;
+    int64_t maxRetryAfter = 60 * 60 * 1000;
+    std::minstd_rand rng{std::random_device()()};
+    CURLM* multi;
+
+    // only changed by the worker thread, with mtx held
+    std::vector<std::unique_ptr<Job>> jobs;
+
+    static constexpr int maxDecoders = 4;
+    static constexpr size_t chunkSize = 64 * 1024;
+    static constexpr size_t decodeQueueSize = 64; // chunks, per decoder
+    static constexpr size_t maxBacklog = 16;      // chunks, per job
+    static constexpr size_t maxFreeBuffers = 32;
+    // one per decoder thread, set up before the worker starts
+    std::vector<std::unique_ptr<BoundedQueue<DecodeTask>>> decodeQueues;
+    size_t nextDecoder = 0;
+    std::atomic<int> backlogged{0}; // jobs with chunks waiting for room
+    std::vector<std::thread> decodeThreads;
+    std::vector<std::unique_ptr<char[]>> freeBuffers;
+    std::mutex bufferMtx;
+    StageStats fetchStage;
+    StageStats decodeStage;
+
+    // Threading
+    bool running = false;
+    std::vector<PollSpec*> pendingAdds;
+    std::vector<PollSpec*> pendingRemoves;
+    std::thread workerThread;
+    std::condition_variable cv;
+    std::mutex mtx;
+};
+
+#endif //__SDRPP_SPOTS_HTTP_SCHEDULER_H
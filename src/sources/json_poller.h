@@ -0,0 +1,145 @@
+#ifndef __SDRPP_SPOTS_JSON_POLLER_H
+#define __SDRPP_SPOTS_JSON_POLLER_H
+
+#include <string>
+#include <vector>
+#include <initializer_list>
+#include "http_poller.h"
+#include "../json_stream.h"
+
+/**********************************************
+ * An HTTP source whose response is a JSON array of flat records.
+ * The body is parsed in whatever chunks it's handed over in. Each
+ * record's text is only scanned for where it ends and fingerprinted,
+ * records whose text is the same as in the last response are skipped
+ * there. The others are parsed on their own and their fields collected
+ * into reused buffers, then handed to processRecord(). No document is
+ * ever built, we only hold one record at a time.
+ *
+ * Records are the objects at recordDepth, optionally only under the
+ * top level key recordsKey. Only scalar fields named in fields() are
+ * kept, as text. null counts as missing.
+ **********************************************/
+class JSONPoller : public HTTPPoller, private JSONHandler {
+public:
+    JSONPoller() : parser(this), record(this) {}
+
+protected:
+    // the fields processRecord() wants, field(i) is the i-th of these
+    void fields(std::initializer_list<const char*> names) {
+        fieldNames.assign(names.begin(), names.end());
+        values.assign(fieldNames.size(), std::string());
+        present.assign(fieldNames.size(), false);
+    }
+
+    bool has(size_t i) const { return present[i]; }
+    const std::string& field(size_t i) const { return values[i]; }
+    const char* field(size_t i, const char* missing) const { return present[i] ? values[i].c_str() : missing; }
+
+    // called for each complete record, push any spot it makes with
+    // pushSpot(). false if the record didn't decode
+    virtual bool processRecord() = 0;
+
+    virtual void beginResponse() {
+        parser.reset();
+        topKey.clear();
+        currentField = -1;
+    }
+
+    virtual void processData(const char* data, size_t len) {
+        if (parser.failed()) { return; }
+        if (!parser.feed(data, len)) {
+            // records before the error still count
+            flog::error("error parsing {0}: {1} at {2}", url, parser.error(), parser.errorOffset());
+        }
+    }
+
+    virtual void endResponse() {
+        if (!parser.failed() && !parser.finish()) {
+            flog::error("error parsing {0}: {1}", url, parser.error());
+        }
+    }
+
+    size_t recordDepth = 2;
+    const char* recordsKey = NULL;
+
+private:
+    bool inRecords() const {
+        return recordsKey == NULL || topKey == recordsKey;
+    }
+
+    virtual void startObject() {
+        currentField = -1;
+        if (!inRecord && parser.depth() == recordDepth && inRecords()) {
+            parser.skipContainer();
+        }
+    }
+
+    // a record's text, from parser
+    virtual void skipped(const std::string& text) {
+        uint64_t hash = fnv1a(text.data(), text.size());
+        if (rows.seen(hash)) { return; }
+
+        present.assign(present.size(), false);
+        currentField = -1;
+        record.reset();
+        inRecord = true;
+        bool ok = record.feed(text.data(), text.size()) && record.finish();
+        inRecord = false;
+        if (!ok) {
+            // the rest of the response is still good
+            flog::error("error parsing a record from {0}: {1} at {2}", url, record.error(), record.errorOffset());
+            rejectRow();
+            return;
+        }
+        // records are independent, a bad one is bad every poll
+        rows.keep(hash);
+        if (!processRecord()) { rejectRow(); }
+    }
+
+    virtual void startArray() {
+        currentField = -1;
+    }
+
+    // record fields are at the top of the record parser
+    bool atFields() const {
+        return inRecord && record.depth() == 1;
+    }
+
+    virtual void key(const std::string& k) {
+        if (!inRecord && parser.depth() == 1) {
+            topKey = k;
+        }
+        currentField = -1;
+        if (!atFields()) { return; }
+        for (size_t i = 0; i < fieldNames.size(); i++) {
+            if (k == fieldNames[i]) {
+                currentField = i;
+                return;
+            }
+        }
+    }
+
+    void scalar(const std::string& v) {
+        if (currentField < 0 || !atFields()) { return; }
+        values[currentField].assign(v);
+        present[currentField] = true;
+        currentField = -1;
+    }
+
+    virtual void string(const std::string& s) { scalar(s); }
+    virtual void number(const std::string& n) { scalar(n); }
+    virtual void boolean(bool b) { scalar(b ? "true" : "false"); }
+    virtual void null() { currentField = -1; }
+
+    JSONStream parser;
+    JSONStream record;
+    bool inRecord = false;
+    std::string topKey;
+    std::vector<const char*> fieldNames;
+    std::vector<std::string> values;
+    std::vector<bool> present;
+    int currentField = -1;
+};
+
+#endif //__SDRPP_SPOTS_JSON_POLLER_H
@@ -0,0 +1,64 @@
+#ifndef __SDRPP_SPOTS_ROW_FILTER_H
+#define __SDRPP_SPOTS_ROW_FILTER_H
+
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+
+/**********************************************
+ * Remembers fingerprints of the rows in the last response we kept, so
+ * a poll that mostly repeats the last one can drop those rows before
+ * decoding them.
+ * Two generations: rows of the response in progress are collected
+ * separately and only replace the last response's on commit(), so a
+ * failed or dropped response never hides rows we didn't hand over.
+ **********************************************/
+class RowFilter {
+public:
+    void begin() {
+        next.clear();
+        fresh = 0;
+        skipped = 0;
+    }
+
+    // true if the row was in the last kept response and can be skipped
+    bool seen(uint64_t fingerprint) {
+        if (last.count(fingerprint)) {
+            next.push_back(fingerprint);
+            skipped++;
+            return true;
+        }
+        fresh++;
+        return false;
+    }
+
+    // a row seen() didn't know decoded, so it can be skipped next time.
+    // rows that didn't decode are left out so every poll treats them the
+    // same
+    void keep(uint64_t fingerprint) {
+        next.push_back(fingerprint);
+    }
+
+    // the response in progress was kept
+    void commit() {
+        last.clear();
+        last.insert(next.begin(), next.end());
+        next.clear();
+    }
+
+    // forget everything, e.g. when the spots we handed over are gone
+    void reset() {
+        last.clear();
+        next.clear();
+    }
+
+    // for the response in progress
+    size_t fresh = 0;
+    size_t skipped = 0;
+
+private:
+    std::unordered_set<uint64_t> last;
+    std::vector<uint64_t> next;
+};
+
+#endif //__SDRPP_SPOTS_ROW_FILTER_H
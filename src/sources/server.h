@@ -0,0 +1,335 @@
+#ifndef __SDRPP_SPOTS_SERVER_H
+#define __SDRPP_SPOTS_SERVER_H
+
+#include <string>
+#include <chrono>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <utils/flog.h>
+#include "../main.h"
+#include "../line_ring.h"
+#include "../spot_time.h"
+
+/**********************************************
+ * Listens for spots pushed by local scripts and skimmers, like spots.sh.
+ * One line per spot, tab separated:
+ * DX <spotter> <kHz> <call> <comment> <HHMM YYYY-MM-DD> <location>
+ * over TCP (any number of connections) or UDP (any number of lines per
+ * datagram), on the same port.
+ *
+ * One thread runs an epoll loop over everything. Each connection frames
+ * lines in its own fixed LineRing, datagrams are parsed right out of
+ * the receive buffer, and whatever one wakeup produced goes to the
+ * store as a single batch.
+ **********************************************/
+class SpotServer : public SpotProvider {
+public:
+    SpotServer() {}
+
+    virtual ~SpotServer() {
+        stop();
+    }
+
+    // takes effect on the next start
+    void setListen(const std::string& host, int port) {
+        std::lock_guard lk(mtx);
+        this->host = host;
+        this->port = port;
+    }
+
+    bool start() {
+        std::lock_guard lk(mtx);
+        if (running) { return true; }
+        if (!openSockets()) {
+            closeSockets();
+            return false;
+        }
+        running = true;
+        flog::info("spot server listening on {0}:{1}", host, port);
+        workerThread = std::thread(&SpotServer::worker, this);
+        return true;
+    }
+
+    void stop() {
+        std::unique_lock lk(mtx);
+        if (!running) { return; }
+        running = false;
+        lk.unlock();
+
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            flog::error("spot server could not wake worker: {0}", strerror(errno));
+        }
+        if (workerThread.joinable()) { workerThread.join(); }
+        closeSockets();
+    }
+
+    // DX<tab>spotter<tab>kHz<tab>call<tab>comment<tab>HHMM YYYY-MM-DD<tab>location
+    static bool parseSpotLine(std::string_view line, Spot* spot) {
+        std::string_view parts[maxFields];
+        size_t count = splitFields(line, '\t', parts, maxFields);
+        if (count < 6 || parts[0] != "DX" || parts[3].empty()) { return false; }
+
+        double frequency;
+        if (!parseDecimal(parts[2], &frequency) || frequency <= 0) { return false; }
+        if (parseTime(parts[5], &spot->spotTime) != 0) { return false; }
+
+        spot->frequency = frequency * 1000;
+        spot->label.assign(parts[3]);
+        spot->spotter.assign(parts[1]);
+        spot->comment.assign(parts[4]);
+        if (count > 6) {
+            spot->location.assign(parts[6]);
+        } else {
+            spot->location.clear();
+        }
+        return true;
+    }
+
+    int maxConnections = 256;
+
+private:
+    struct Connection {
+        Connection(int fd) : fd(fd), lines(4096) {}
+        int fd;
+        LineRing lines;
+    };
+
+    static constexpr size_t maxFields = 8;
+
+    // with mtx held
+    bool openSockets() {
+        wakeFd = eventfd(0, EFD_NONBLOCK);
+        epollFd = epoll_create1(0);
+        if (wakeFd < 0 || epollFd < 0) {
+            flog::error("spot server could not set up epoll: {0}", strerror(errno));
+            return false;
+        }
+        listenFd = bindSocket(SOCK_STREAM);
+        udpFd = bindSocket(SOCK_DGRAM);
+        if (listenFd < 0 || udpFd < 0) {
+            return false;
+        }
+        if (listen(listenFd, 64) != 0) {
+            flog::error("spot server could not listen: {0}", strerror(errno));
+            return false;
+        }
+        watch(wakeFd);
+        watch(listenFd);
+        watch(udpFd);
+        return true;
+    }
+
+    void closeSockets() {
+        for (auto& conn : connections) {
+            close(conn.first);
+        }
+        connections.clear();
+        for (int* fd : {&listenFd, &udpFd, &epollFd, &wakeFd}) {
+            if (*fd >= 0) { close(*fd); }
+            *fd = -1;
+        }
+    }
+
+    int bindSocket(int type) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = type;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* addrs;
+        std::string service = std::to_string(port);
+        int err = getaddrinfo(host.empty() ? NULL : host.c_str(), service.c_str(), &hints, &addrs);
+        if (err != 0) {
+            flog::error("spot server could not resolve {0}: {1}", host, gai_strerror(err));
+            return -1;
+        }
+        // the first address that binds, an empty host can give an IPv6
+        // wildcard on a machine without IPv6 before the IPv4 one
+        int fd = -1;
+        int bindError = 0;
+        for (addrinfo* a = addrs; a && fd < 0; a = a->ai_next) {
+            fd = socket(a->ai_family, a->ai_socktype | SOCK_NONBLOCK, a->ai_protocol);
+            if (fd < 0) {
+                bindError = errno;
+                continue;
+            }
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (bind(fd, a->ai_addr, a->ai_addrlen) != 0) {
+                bindError = errno;
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addrs);
+        if (fd < 0) {
+            flog::error("spot server could not bind {0}:{1}: {2}", host, port, strerror(bindError));
+        }
+        return fd;
+    }
+
+    void watch(int fd) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void worker() {
+        flog::info("spot server starting...");
+        epoll_event events[64];
+        std::vector<Spot> spots;
+        bool stopping = false;
+        while (!stopping) {
+            // wake up in time to report bad lines that are waiting
+            int ready = epoll_wait(epollFd, events, 64, badLines > 0 ? badLineWarnPeriod : -1);
+            if (ready < 0) {
+                if (errno == EINTR) { continue; }
+                flog::error("spot server epoll failed: {0}", strerror(errno));
+                break;
+            }
+            auto parseStart = std::chrono::steady_clock::now();
+            for (int i = 0; i < ready; i++) {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd) {
+                    stopping = true;
+                } else if (fd == listenFd) {
+                    acceptAll();
+                } else if (fd == udpFd) {
+                    readDatagrams(spots);
+                } else {
+                    readConnection(fd, spots);
+                }
+            }
+            if (!spots.empty()) {
+                // reads are non-blocking, so this is all decoding
+                providerStats.parseTime.observeSince(parseStart);
+                providerStats.rowsDecoded += spots.size();
+            }
+            addSpots(std::move(spots));
+            spots.clear();
+            warnBadLines();
+        }
+        flog::info("spot server stopping.");
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    flog::error("spot server accept failed: {0}", strerror(errno));
+                }
+                return;
+            }
+            if ((int)connections.size() >= maxConnections) {
+                flog::warn("spot server has too many connections, dropping one");
+                close(fd);
+                continue;
+            }
+            connections.emplace(fd, std::make_unique<Connection>(fd));
+            watch(fd);
+        }
+    }
+
+    void readConnection(int fd, std::vector<Spot>& spots) {
+        auto conn = connections.find(fd);
+        if (conn == connections.end()) { return; }
+        LineRing& lines = conn->second->lines;
+
+        size_t space;
+        char* dst = lines.writable(&space);
+        ssize_t n = recv(fd, dst, space, 0);
+        if (n > 0) { providerStats.bytesReceived += n; }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) { return; }
+        if (n <= 0) {
+            // closed, or broken. a last line without a newline still
+            // counts, unless it's the end of one too long to keep
+            parseLine(lines.partial(), spots);
+            close(fd);
+            connections.erase(conn);
+            return;
+        }
+        lines.commit(n);
+        std::string_view line;
+        while (lines.nextLine(&line)) {
+            parseLine(line, spots);
+        }
+    }
+
+    void readDatagrams(std::vector<Spot>& spots) {
+        // drain what's queued, but give the other sockets a turn
+        for (int i = 0; i < 64; i++) {
+            ssize_t n = recv(udpFd, datagram, sizeof(datagram), 0);
+            if (n <= 0) { return; }
+            providerStats.bytesReceived += n;
+            std::string_view lines(datagram, n);
+            while (!lines.empty()) {
+                size_t newline = std::min(lines.find('\n'), lines.size());
+                std::string_view line = lines.substr(0, newline);
+                if (!line.empty() && line.back() == '\r') { line.remove_suffix(1); }
+                parseLine(line, spots);
+                lines.remove_prefix(std::min(newline + 1, lines.size()));
+            }
+        }
+    }
+
+    void parseLine(std::string_view line, std::vector<Spot>& spots) {
+        if (line.empty()) { return; }
+        spots.emplace_back();
+        if (!parseSpotLine(line, &spots.back())) {
+            spots.pop_back();
+            providerStats.rowsInvalid++;
+            if (badLines++ == 0) {
+                badLine.assign(line.substr(0, 200));
+            }
+        }
+    }
+
+    // one warning per period however much garbage clients send, with
+    // the first bad line as an example
+    void warnBadLines() {
+        if (badLines == 0) { return; }
+        auto now = std::chrono::steady_clock::now();
+        if (now - badLinesWarned < std::chrono::milliseconds(badLineWarnPeriod)) { return; }
+        flog::warn("spot server got {0} bad lines, like: {1}", badLines, badLine);
+        badLines = 0;
+        badLinesWarned = now;
+    }
+
+    std::string host = "localhost";
+    int port = 6214;
+
+    // only touched by the worker while it's running
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    char datagram[65536];
+    size_t badLines = 0; // since the last warning
+    std::string badLine;
+    std::chrono::steady_clock::time_point badLinesWarned;
+    static constexpr int badLineWarnPeriod = 10000; // ms
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    int listenFd = -1;
+    int udpFd = -1;
+
+    // Threading
+    bool running = false;
+    std::thread workerThread;
+    std::mutex mtx;
+};
+
+#endif //__SDRPP_SPOTS_SERVER_H
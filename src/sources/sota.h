@@ -1,58 +1,50 @@
 #ifndef __SDRPP_SPOTS_SOTA_H
 #define __SDRPP_SPOTS_SOTA_H
 
-#include "http_poller.h"
+#include "json_poller.h"
+#include "../spot_time.h"
 
-class SOTAProvider : public HTTPPoller {
+class SOTAProvider : public JSONPoller {
 public:
     SOTAProvider() {
         strcpy(url, "https://api2.sota.org.uk/api/spots/-2/all");
+        fields({"activatorCallsign", "callsign", "frequency", "timeStamp", "comments", "summitDetails"});
     }
 protected:
-    virtual void processResponse(std::string response) {
-        json jsonSpots = json::parse(response);
-        try {
-            for(const auto& jsonSpot : jsonSpots.items()) {
-                std::string label = jsonSpot.value()["activatorCallsign"];
-                std::string spotter = jsonSpot.value()["callsign"];
-                double frequency = std::stod(jsonSpot.value()["frequency"].get<std::string>())*1000*1000;
-                std::string spotTimeString = jsonSpot.value()["timeStamp"].get<std::string>();
-                std::tm t = {};
-                int y,M,d,h,m;
-                float s;
-                sscanf(spotTimeString.c_str(), "%d-%d-%dT%d:%d:%f", &y, &M, &d, &h, &m, &s);
-                std::tm time = { 0 };
-                time.tm_year = y - 1900; // Year since 1900
-                time.tm_mon = M - 1;     // 0-11
-                time.tm_mday = d;        // 1-31
-                time.tm_hour = h;        // 0-23
-                time.tm_min = m;         // 0-59
-                time.tm_sec = (int)s;    // 0-61 (0-60 in C++11)
-                // expressed in UTC
-                // from https://stackoverflow.com/a/38298359
-                std::time_t tLocal = std::mktime(&time);
-                time_t tUTC = tLocal + (std::mktime(std::localtime(&tLocal)) - std::mktime(std::gmtime(&tLocal)));
-                std::chrono::time_point<std::chrono::system_clock> spotTime = std::chrono::system_clock::from_time_t(tUTC);
+    enum { ACTIVATOR_CALLSIGN, CALLSIGN, FREQUENCY, TIME_STAMP, COMMENTS, SUMMIT_DETAILS };
 
-                std::string comment = "";
-                if (!jsonSpot.value()["comments"].is_null()) {
-                    comment = jsonSpot.value()["comments"].get<std::string>()+" "+jsonSpot.value()["comments"].get<std::string>();
-                }
-                std::string location = jsonSpot.value()["summitDetails"];
+    virtual bool processRecord() {
+        if (!has(ACTIVATOR_CALLSIGN) || !has(FREQUENCY) || !has(TIME_STAMP)) {
+            flog::error("error parsing sotawatch spot, missing fields");
+            return false;
+        }
+        char* end;
+        double frequency = std::strtod(field(FREQUENCY).c_str(), &end)*1000*1000;
+        if (end == field(FREQUENCY).c_str()) {
+            flog::error("error parsing sotawatch spot, bad frequency {0}", field(FREQUENCY));
+            return false;
+        }
+        // expressed in UTC
+        SpotTime spotTime;
+        if (!parseIsoTime(field(TIME_STAMP), &spotTime)) {
+            flog::error("error parsing sotawatch spot, bad time stamp {0}", field(TIME_STAMP));
+            return false;
+        }
 
-                Spot spot = {
-                    label,
-                    spotter,
-                    frequency,
-                    spotTime,
-                    comment,
-                    location
-                };
-                addSpot(spot);
-            }
-        } catch (const json::type_error& e) {
-            flog::error("error parsing sotawatch {0}", e.what());
+        std::string comment = "";
+        if (has(COMMENTS)) {
+            comment = field(COMMENTS)+" "+field(COMMENTS);
         }
+
+        pushSpot({
+            field(ACTIVATOR_CALLSIGN),
+            field(CALLSIGN, ""),
+            frequency,
+            spotTime,
+            std::move(comment),
+            field(SUMMIT_DETAILS, "")
+        });
+        return true;
     }
 };
 
@@ -0,0 +1,575 @@
+#ifndef __SDRPP_SPOTS_SPOT_HUB_H
+#define __SDRPP_SPOTS_SPOT_HUB_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <utils/flog.h>
+#include "main.h"
+#include "metrics.h"
+#include "bounded_queue.h"
+#include "spot_store.h"
+#include "spot_time.h"
+#include "sources/hamqth.h"
+#include "sources/pota.h"
+#include "sources/sota.h"
+#include "sources/wwff.h"
+#ifndef _WIN32
+#include <dirent.h>
+#include "spot_journal.h"
+#include "sources/dxcluster.h"
+#endif
+#ifdef __linux__
+#include "sources/server.h"
+#endif
+
+// what happened to a source's spots once they reached the store
+struct SourceStats {
+    std::atomic<uint64_t> accepted{0}; // new, or changed what we had
+    std::atomic<uint64_t> deduped{0};  // the same as what we had
+    std::atomic<uint64_t> expired{0};
+    std::atomic<uint64_t> dropped{0};  // already expired when they arrived
+    Histogram lockWait;                // waiting on the store lock to add them
+    // subscribed, but the provider wouldn't start with its settings
+    std::atomic<bool> startFailed{false};
+};
+
+// one provider, shared by every module instance
+// index is its position in SpotHub::sources(), and its store id
+struct SpotSource {
+    std::string name;
+    std::string label;
+    size_t index;
+    std::unique_ptr<SpotProvider> provider;
+    SourceStats stats;
+    // instances that want it running, changed with SpotHub::mtx held
+    std::atomic<int> subscribers{0};
+    // bumped when its spots are erased, batches from before are stale
+    std::atomic<uint32_t> generation{0};
+};
+
+// spots from one provider callback, on their way to the merge thread
+struct SpotBatch {
+    std::vector<Spot> spots;
+    SpotSource* source;
+    uint32_t generation; // the source's, when provided
+    std::chrono::steady_clock::time_point queued;
+};
+
+// where the hub's providers connect and how long it keeps spots, the
+// same for every instance
+struct HubSettings {
+    std::string root; // for the journal and metrics file
+    std::string host = "localhost";
+    int port = 6214;
+    std::string clusterHost;
+    int clusterPort = 23;
+    std::string clusterCallsign;
+    int maxSpotLifetime = 240; // minutes
+};
+
+/**********************************************
+ * Everything module instances can share: the providers, the spot store
+ * with its journal, and the merge and expiry threads. The first
+ * instance creates it and the last one to let go stops it, so polling
+ * and memory cost the same however many instances there are.
+ *
+ * Instances subscribe to the sources they show. A provider runs while
+ * any instance subscribes to it, and its spots are dropped from the
+ * store when the last one unsubscribes. Spots restored from the journal
+ * wait for the first instance to start, those of sources it leaves
+ * without subscribers are dropped then. Which spots to draw, and in what
+ * color, is up to each instance.
+ **********************************************/
+class SpotHub {
+public:
+    // the shared hub, created with settings if there isn't one
+    static std::shared_ptr<SpotHub> acquire(const HubSettings& settings) {
+        static std::weak_ptr<SpotHub> shared;
+        static std::mutex sharedMtx;
+        std::lock_guard lk(sharedMtx);
+        std::shared_ptr<SpotHub> hub = shared.lock();
+        if (!hub) {
+            hub = std::shared_ptr<SpotHub>(new SpotHub(settings));
+            shared = hub;
+        }
+        return hub;
+    }
+
+    ~SpotHub() {
+        for (auto& source : spotSources) {
+            flog::info("stopping provider {0}", source->name);
+            source->provider->stop();
+        }
+        stopMerge();
+        stopExpiry();
+    }
+
+    const std::vector<std::unique_ptr<SpotSource>>& sources() const { return spotSources; }
+
+    // the latest snapshot of every source's spots
+    std::shared_ptr<const SpotSnapshot> current() const { return store.current(); }
+
+    int maxSpotLifetime() const { return settings.maxSpotLifetime; }
+
+    // start the source's provider if nobody had yet
+    void subscribe(SpotSource* source) {
+        std::lock_guard lk(mtx);
+        if (source->subscribers++ == 0) {
+            flog::info("starting provider {0}", source->name);
+            source->stats.startFailed = !source->provider->start();
+        }
+    }
+
+    // an instance started and subscribed to everything it shows. the
+    // first time, restored spots of sources nobody subscribed to are
+    // dropped, they'd only sit in the store and journal until expiry
+    void subscribed() {
+        std::lock_guard lk(mtx);
+        if (!restoredUnclaimed) { return; }
+        restoredUnclaimed = false;
+
+        std::lock_guard slk(storeMutex);
+        size_t erased = 0;
+        for (auto& source : spotSources) {
+            if (source->subscribers == 0) {
+                changedSpots.clear();
+                erased += store.eraseSource(source.get(), &changedSpots);
+#ifndef _WIN32
+                journal.eraseSource(source.get(), changedSpots, store);
+#endif
+            }
+        }
+        if (erased > 0) {
+            store.publish();
+            flog::info("dropped {0} restored spots of unused sources", erased);
+        }
+    }
+
+    // stop the source's provider, and forget its spots, once nobody
+    // wants it
+    void unsubscribe(SpotSource* source) {
+        std::lock_guard lk(mtx);
+        if (source->subscribers == 0 || --source->subscribers > 0) { return; }
+        flog::info("stopping provider {0}", source->name);
+        source->provider->stop();
+        source->stats.startFailed = false;
+
+        // batches it already queued would bring the spots back
+        std::lock_guard slk(storeMutex);
+        source->generation++;
+        changedSpots.clear();
+        store.eraseSource(source, &changedSpots);
+#ifndef _WIN32
+        journal.eraseSource(source, changedSpots, store);
+#endif
+        store.publish();
+    }
+
+    // providers only pick these up when they (re)start
+#ifdef __linux__
+    void setListen(const std::string& host, int port) { spotServer->setListen(host, port); }
+#endif
+#ifndef _WIN32
+    void setCluster(const std::string& host, int port, const std::string& callsign) { dxCluster->setServer(host, port, callsign); }
+#endif
+
+    // the pipeline stages spots go through, in order
+    std::vector<std::pair<const char*, const StageStats*>> stages() const {
+        HTTPScheduler& scheduler = HTTPScheduler::instance();
+        return {{"Fetch", &scheduler.fetchStats()}, {"Decode", &scheduler.decodeStats()}, {"Merge", &mergeStage}};
+    }
+
+    // write metrics every expiry period to <root>/spots.prom, render
+    // stats for every instance that added theirs included
+    void setMetricsFile(bool write) { metricsFile = write; }
+    void addRenderStats(const std::string& name, const RenderStats* stats) {
+        std::lock_guard lk(renderMtx);
+        renderStats.emplace_back(name, stats);
+    }
+    void removeRenderStats(const RenderStats* stats) {
+        std::lock_guard lk(renderMtx);
+        renderStats.erase(std::remove_if(renderStats.begin(), renderStats.end(),
+                [stats](const std::pair<std::string, const RenderStats*>& r) { return r.second == stats; }), renderStats.end());
+    }
+
+private:
+    SpotHub(const HubSettings& settings) : settings(settings) {
+        addSource("hamqth", "HamQTH ClusterDX", std::make_unique<HamQTHProvider>());
+        addSource("pota", "POTA.app spots", std::make_unique<POTAProvider>());
+        addSource("sota", "SOTAwatch spots", std::make_unique<SOTAProvider>());
+        addSource("wwff", "WWFF spots", std::make_unique<WWFFProvider>());
+#ifdef __linux__
+        auto spotServer = std::make_unique<SpotServer>();
+        spotServer->setListen(settings.host, settings.port);
+        this->spotServer = spotServer.get();
+        addSource("server", "Local spot server", std::move(spotServer));
+#endif
+#ifndef _WIN32
+        auto dxCluster = std::make_unique<DXClusterProvider>();
+        dxCluster->setServer(settings.clusterHost, settings.clusterPort, settings.clusterCallsign);
+        this->dxCluster = dxCluster.get();
+        addSource("dxcluster", "DX cluster (telnet)", std::move(dxCluster));
+#endif
+
+#ifndef _WIN32
+        // put back what we had before a restart, before anything polls
+        restoreJournal();
+#endif
+        startMerge();
+        startExpiry();
+    }
+
+    void addSource(const std::string& name, const std::string& label, std::unique_ptr<SpotProvider>&& provider) {
+        flog::info("initializing source {0}", name);
+        auto source = std::make_unique<SpotSource>();
+        source->name = name;
+        source->label = label;
+        source->index = spotSources.size();
+        source->provider = std::move(provider);
+        source->provider->registerAddSpots(&SpotHub::addSpots, source.get(), this);
+        store.addSource(source.get());
+        spotSources.push_back(std::move(source));
+    }
+
+    // providers hand batches to the merge stage, waiting if it's behind
+    static void addSpots(std::vector<Spot>&& providedSpots, void* sourceCtx, void* ctx) {
+        SpotSource* source = (SpotSource*) sourceCtx;
+        SpotHub* _this = (SpotHub*) ctx;
+
+        _this->mergeStage.depth++;
+        bool stalled;
+        SpotBatch batch = {std::move(providedSpots), source, source->generation, std::chrono::steady_clock::now()};
+        if (!_this->mergeQueue.push(std::move(batch), &stalled)) {
+            // shutting down
+            _this->mergeStage.depth--;
+            return;
+        }
+        if (stalled) { _this->mergeStage.stalls++; }
+    }
+
+    void startMerge() {
+        if (mergeThread.joinable()) { return; }
+        mergeQueue.reopen();
+        mergeThread = std::thread(&SpotHub::mergeWorker, this);
+    }
+
+    void stopMerge() {
+        // merges whatever is still queued first
+        mergeQueue.close();
+        if (mergeThread.joinable()) { mergeThread.join(); }
+    }
+
+    // the only thread adding provided spots to the store. takes whatever
+    // batches have queued up, merges them under one lock and publishes
+    // once
+    void mergeWorker() {
+        std::vector<SpotBatch> batches;
+        SpotBatch batch;
+        while (mergeQueue.pop(batch)) {
+            batches.clear();
+            batches.push_back(std::move(batch));
+            while (batches.size() < maxMergeBatches && mergeQueue.tryPop(batch)) {
+                batches.push_back(std::move(batch));
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (auto& b : batches) {
+                mergeStage.depth--;
+                mergeStage.queueWait.observe(std::chrono::duration<double>(start - b.queued).count());
+                dropExpired(b);
+            }
+
+            auto waitStart = std::chrono::steady_clock::now();
+            std::lock_guard lk(storeMutex);
+            for (auto& b : batches) {
+                b.source->stats.lockWait.observeSince(waitStart);
+            }
+            bool changed = false;
+            for (auto& b : batches) {
+                changed |= mergeBatch(b);
+            }
+            if (changed) {
+                store.publish();
+            }
+            mergeStage.processTime.observeSince(start);
+            mergeStage.items += batches.size();
+        }
+    }
+
+    // silently drop already expired spots
+    void dropExpired(SpotBatch& batch) {
+        auto expirationTime = SpotClock::now() - std::chrono::minutes(settings.maxSpotLifetime);
+        size_t provided = batch.spots.size();
+        batch.spots.erase(
+            std::remove_if(batch.spots.begin(), batch.spots.end(), [&expirationTime](const Spot& s) { return s.spotTime < expirationTime; }),
+            batch.spots.end()
+        );
+        batch.source->stats.dropped += provided - batch.spots.size();
+    }
+
+    // with storeMutex held, returns true if the store changed
+    bool mergeBatch(SpotBatch& batch) {
+        // queued before the source was unsubscribed
+        if (batch.generation != batch.source->generation) { return false; }
+        size_t kept = batch.spots.size();
+        changedSpots.clear();
+        size_t changed = store.merge(std::move(batch.spots), batch.source, &changedSpots);
+        batch.source->stats.accepted += changed;
+        batch.source->stats.deduped += kept - changed;
+        if (changed == 0) { return false; }
+#ifndef _WIN32
+        journal.append(changedSpots, store);
+#endif
+        return true;
+    }
+
+#ifndef _WIN32
+    // restored spots stay until they expire, or until their source's
+    // last subscriber leaves, see subscribed()
+    void restoreJournal() {
+        for (auto& source : spotSources) {
+            journal.addSource(source.get(), source->name);
+        }
+        std::string path = settings.root + "/spots.journal";
+        auto start = std::chrono::steady_clock::now();
+        SpotTime since = SpotClock::now() - std::chrono::minutes(settings.maxSpotLifetime);
+        std::lock_guard lk(storeMutex);
+
+        struct stat st;
+        bool imported = stat(path.c_str(), &st) != 0 && importOldJournals(since);
+        if (!journal.open(path)) { return; }
+        if (imported) {
+            // the new journal starts out with what the old ones had
+            journal.compact(store);
+        } else {
+            journal.replay(store, since);
+        }
+        store.publish();
+        restoredUnclaimed = store.size() > 0;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        flog::info("restored {0} spots from {1} in {2} us", store.size(), path, (int64_t)elapsed.count());
+    }
+
+    // each instance used to keep its own spots_<name>.journal, merge
+    // them into the store and delete them. returns true if there were any
+    bool importOldJournals(SpotTime since) {
+        DIR* dir = opendir(settings.root.c_str());
+        if (!dir) { return false; }
+        std::vector<std::string> paths;
+        while (dirent* entry = readdir(dir)) {
+            std::string_view file = entry->d_name;
+            if (file.size() > 14 && file.substr(0, 6) == "spots_" && file.substr(file.size() - 8) == ".journal") {
+                paths.push_back(settings.root + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+
+        for (const std::string& old : paths) {
+            if (journal.open(old)) {
+                size_t restored = journal.replay(store, since);
+                flog::info("importing {0} spots from old journal {1}", restored, old);
+            }
+            journal.close();
+            if (unlink(old.c_str()) != 0) {
+                flog::warn("could not delete old journal {0}: {1}", old, strerror(errno));
+            }
+        }
+        return !paths.empty();
+    }
+#endif
+
+    void startExpiry() {
+        std::unique_lock lk(expiryMtx);
+        if (expiryRunning) { return; }
+        expiryRunning = true;
+        expiryThread = std::thread(&SpotHub::expiryWorker, this);
+    }
+
+    void stopExpiry() {
+        std::unique_lock lk(expiryMtx);
+        if (!expiryRunning) { return; }
+        expiryRunning = false;
+        lk.unlock();
+        expiryCv.notify_all();
+        if (expiryThread.joinable()) { expiryThread.join(); }
+    }
+
+    // drops spots older than maxSpotLifetime in the background so the
+    // waterfall doesn't have to, and memory stays bounded while it's hidden
+    void expiryWorker() {
+        std::unique_lock lk(expiryMtx);
+        while (expiryRunning) {
+            auto expirationTime = SpotClock::now() - std::chrono::minutes(settings.maxSpotLifetime);
+            size_t expired;
+            {
+                std::lock_guard slk(storeMutex);
+                expiredSpots.clear();
+                expired = store.expire(expirationTime, &expiredSpots);
+                if (expired > 0) {
+                    store.publish();
+#ifndef _WIN32
+                    journal.expire(expirationTime);
+#endif
+                }
+                for (const SpotRecord& spot : expiredSpots) {
+                    spot.source->stats.expired++;
+                }
+#ifndef _WIN32
+                if (journal.wantsCompaction(store.size())) {
+                    journal.compact(store);
+                }
+#endif
+            }
+            if (expired > 0) {
+                flog::info("expired {0} spots", expired);
+            }
+            if (metricsFile) {
+                writeMetrics();
+            }
+            expiryCv.wait_for(lk, std::chrono::milliseconds(expiryPeriod));
+        }
+    }
+
+    // everything the metrics menu shows, as a Prometheus text file next
+    // to the config for node_exporter's textfile collector (or anything
+    // else) to pick up
+    void writeMetrics() {
+        PrometheusWriter w;
+        std::vector<std::string> labels;
+        for (auto& source : spotSources) {
+            labels.push_back(PrometheusWriter::label("source", source->name));
+        }
+
+        // one metric at a time, across every source
+        auto counter = [&](const char* metric, const char* help, auto value) {
+            w.metric(metric, "counter", help);
+            for (size_t i = 0; i < spotSources.size(); i++) {
+                w.sample(metric, labels[i], value(*spotSources[i]));
+            }
+        };
+        auto gauge = [&](const char* metric, const char* help, auto value) {
+            w.metric(metric, "gauge", help);
+            for (size_t i = 0; i < spotSources.size(); i++) {
+                w.sample(metric, labels[i], value(*spotSources[i]));
+            }
+        };
+        auto histogram = [&](const char* metric, const char* help, auto hist) {
+            w.metric(metric, "histogram", help);
+            for (size_t i = 0; i < spotSources.size(); i++) {
+                w.histogram(metric, labels[i], hist(*spotSources[i]));
+            }
+        };
+        typedef const SpotSource& S;
+        counter("spots_fetches_total", "Polls or connection attempts.", [](S s) { return s.provider->stats().fetches.load(); });
+        counter("spots_fetch_failures_total", "Failed polls or connection attempts.", [](S s) { return s.provider->stats().failures.load(); });
+        gauge("spots_fetch_consecutive_failures", "Failed fetches since the last good one.", [](S s) { return s.provider->stats().consecutiveFailures.load(); });
+        gauge("spots_poll_interval_seconds", "Time between polls, as adapted to the source.", [](S s) { return s.provider->stats().pollInterval / 1e3; });
+        gauge("spots_subscribers", "Module instances showing the source.", [](S s) { return s.subscribers.load(); });
+        gauge("spots_start_failed", "1 if the source is shown but could not start with its settings.", [](S s) { return s.stats.startFailed ? 1 : 0; });
+        histogram("spots_fetch_seconds", "Time to poll, or to connect.", [](S s) -> const Histogram& { return s.provider->stats().fetchLatency; });
+        counter("spots_received_bytes_total", "Bytes received, maybe compressed.", [](S s) { return s.provider->stats().bytesReceived.load(); });
+        counter("spots_http_not_modified_total", "Polls answered with a 304.", [](S s) { return s.provider->stats().notModified.load(); });
+        counter("spots_http_unchanged_total", "Polls with the same body as last time.", [](S s) { return s.provider->stats().unchanged.load(); });
+        counter("spots_http_saved_bytes_total", "Bytes saved by conditional requests and compression.", [](S s) { return s.provider->stats().bytesSaved.load(); });
+        histogram("spots_parse_seconds", "Time decoding a response or a read.", [](S s) -> const Histogram& { return s.provider->stats().parseTime; });
+        counter("spots_rows_decoded_total", "Rows decoded into spots.", [](S s) { return s.provider->stats().rowsDecoded.load(); });
+        counter("spots_rows_skipped_total", "Rows skipped as seen in the last poll.", [](S s) { return s.provider->stats().rowsSkipped.load(); });
+        counter("spots_rows_invalid_total", "Rows that did not decode.", [](S s) { return s.provider->stats().rowsInvalid.load(); });
+        counter("spots_rows_filtered_total", "Rows left out on purpose, like cluster chatter.", [](S s) { return s.provider->stats().rowsFiltered.load(); });
+        counter("spots_accepted_total", "Spots that were new or changed the stored spot.", [](S s) { return s.stats.accepted.load(); });
+        counter("spots_deduped_total", "Spots the same as the stored spot.", [](S s) { return s.stats.deduped.load(); });
+        counter("spots_expired_total", "Spots dropped from the store as too old.", [](S s) { return s.stats.expired.load(); });
+        counter("spots_dropped_total", "Spots already expired when they arrived.", [](S s) { return s.stats.dropped.load(); });
+        histogram("spots_store_lock_wait_seconds", "Time waiting on the store lock to add spots.", [](S s) -> const Histogram& { return s.stats.lockWait; });
+
+        w.metric("spots_stored", "gauge", "Spots in the store.");
+        w.sample("spots_stored", "", store.current()->spots.size());
+
+        std::vector<std::pair<std::string, const StageStats*>> stageLabels;
+        for (auto& stage : stages()) {
+            std::string stageName = stage.first;
+            std::transform(stageName.begin(), stageName.end(), stageName.begin(), ::tolower);
+            stageLabels.emplace_back(PrometheusWriter::label("stage", stageName), stage.second);
+        }
+        w.metric("spots_stage_depth", "gauge", "Items waiting for a pipeline stage (in flight, for fetch).");
+        for (auto& stage : stageLabels) { w.sample("spots_stage_depth", stage.first, stage.second->depth); }
+        w.metric("spots_stage_items_total", "counter", "Items a pipeline stage processed.");
+        for (auto& stage : stageLabels) { w.sample("spots_stage_items_total", stage.first, stage.second->items); }
+        w.metric("spots_stage_stalls_total", "counter", "Times a pipeline stage's queue was full.");
+        for (auto& stage : stageLabels) { w.sample("spots_stage_stalls_total", stage.first, stage.second->stalls); }
+        w.metric("spots_stage_wait_seconds", "histogram", "Time from queued to picked up by a pipeline stage.");
+        for (auto& stage : stageLabels) { w.histogram("spots_stage_wait_seconds", stage.first, stage.second->queueWait); }
+        w.metric("spots_stage_process_seconds", "histogram", "Time a pipeline stage spent per item, or per group of batches for merge.");
+        for (auto& stage : stageLabels) { w.histogram("spots_stage_process_seconds", stage.first, stage.second->processTime); }
+
+        // and what each instance draws
+        std::lock_guard lk(renderMtx);
+        std::vector<std::string> modules;
+        for (auto& r : renderStats) {
+            modules.push_back(PrometheusWriter::label("module", r.first));
+        }
+        w.metric("spots_redraw_seconds", "histogram", "Time drawing spots on the waterfall per frame.");
+        for (size_t i = 0; i < renderStats.size(); i++) { w.histogram("spots_redraw_seconds", modules[i], renderStats[i].second->redrawTime); }
+        w.metric("spots_labels_visible", "gauge", "Labels drawn in the last frame.");
+        for (size_t i = 0; i < renderStats.size(); i++) { w.sample("spots_labels_visible", modules[i], renderStats[i].second->labelsVisible); }
+        w.metric("spots_labels_laid_out", "gauge", "Labels in the current layout.");
+        for (size_t i = 0; i < renderStats.size(); i++) { w.sample("spots_labels_laid_out", modules[i], renderStats[i].second->labelsLaidOut); }
+        w.metric("spots_labels_dropped", "gauge", "Displayable spots without a label of their own, grouped into badges or dropped.");
+        for (size_t i = 0; i < renderStats.size(); i++) { w.sample("spots_labels_dropped", modules[i], renderStats[i].second->labelsDropped); }
+
+        std::string path = settings.root + "/spots.prom";
+        if (!w.writeFile(path)) {
+            flog::error("could not write metrics to {0}", path);
+        }
+    }
+
+    HubSettings settings;
+    std::vector<std::unique_ptr<SpotSource>> spotSources;
+#ifdef __linux__
+    // owned by its SpotSource
+    SpotServer* spotServer = NULL;
+#endif
+#ifndef _WIN32
+    // owned by its SpotSource
+    DXClusterProvider* dxCluster = NULL;
+#endif
+
+    // the merge thread, expiry and unsubscribes take storeMutex and
+    // publish, instances read published snapshots without locking
+    SpotStore store;
+    std::vector<SpotRecord> changedSpots;
+    std::vector<SpotRecord> expiredSpots;
+#ifndef _WIN32
+    // spots as they changed, to restore after a restart
+    SpotJournal journal;
+#endif
+    // restored spots are waiting for subscribed(), under mtx
+    bool restoredUnclaimed = false;
+    std::mutex storeMutex;
+
+    static constexpr size_t maxMergeBatches = 32;
+    BoundedQueue<SpotBatch> mergeQueue = BoundedQueue<SpotBatch>(256);
+    StageStats mergeStage;
+    std::thread mergeThread;
+
+    std::atomic<bool> metricsFile{false};
+    std::vector<std::pair<std::string, const RenderStats*>> renderStats;
+    std::mutex renderMtx;
+
+    // Threading
+    std::mutex mtx; // subscriptions
+    int expiryPeriod = 10000;
+    bool expiryRunning = false;
+    std::thread expiryThread;
+    std::condition_variable expiryCv;
+    std::mutex expiryMtx;
+};
+
+#endif //__SDRPP_SPOTS_SPOT_HUB_H
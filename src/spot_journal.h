@@ -0,0 +1,694 @@
+#ifndef __SDRPP_SPOTS_SPOT_JOURNAL_H
+#define __SDRPP_SPOTS_SPOT_JOURNAL_H
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <utils/flog.h>
+#include "spot_store.h"
+#include "spot_time.h"
+
+/**********************************************
+ * Append-only, memory mapped journal of the spots that changed the
+ * store, so a restart can put the last few hours back on the waterfall
+ * before any source has polled.
+ *
+ * After a 32 byte header, the file is a sequence of records, each a 4
+ * byte size and 1 byte type:
+ * - source: the source's name, the n-th source record is source id n
+ * - string: the string's bytes, the n-th string in the file, counting
+ *   those of a strings record, is string id n
+ * - spot: source id, frequency in Hz, time in epoch seconds and string
+ *   ids for label, spotter, comment and location
+ * - clear: a source id, the store forgot everything that source reported
+ * - expire: a time, the store dropped every spot from before it
+ * Strings are written once per file, so a spot is 34 bytes. The header
+ * holds how much of the file is committed, which is only bumped after
+ * a batch of records is written, so a crash mid-batch loses that batch
+ * and nothing else.
+ *
+ * Updated spots are appended again, so the journal only grows. compact()
+ * rewrites it as a snapshot of the store: all the strings its spots use
+ * as one strings record (a count, where each string ends, then the bytes
+ * back to back, string ids are positions in it) followed by one snapshot
+ * record, the spots in frequency order laid out like spot records. A
+ * restart loads that into an empty store in bulk and only replays what
+ * was appended after it record by record. The new file is synced before
+ * it replaces the old one. Only a spot's latest report is kept, which
+ * other sources and spotters reported it is not.
+ *
+ * Not thread safe, callers serialize with the same lock as the store.
+ **********************************************/
+class SpotJournal {
+public:
+    SpotJournal() {}
+
+    ~SpotJournal() {
+        close();
+    }
+
+    SpotJournal(const SpotJournal&) = delete;
+    SpotJournal& operator=(const SpotJournal&) = delete;
+
+    // sources are matched to the journal by name, add them all before
+    // open()
+    void addSource(SpotSource* source, const std::string& name) {
+        sources.push_back({source, name, -1});
+    }
+
+    // open the journal at path, creating it if it's missing or unreadable
+    bool open(const std::string& path) {
+        close();
+        this->path = path;
+        if (!mapFile(path)) {
+            close();
+            return false;
+        }
+        static const char blank[headerSize] = {};
+        if (memcmp(map, blank, headerSize) == 0) {
+            // brand new
+            return reset();
+        }
+        if (!scan()) {
+            flog::warn("spot journal {0} is unreadable, starting over", path);
+            return reset();
+        }
+        return true;
+    }
+
+    void close() {
+        if (map) {
+            munmap(map, capacity);
+            // give back the room we grew into but didn't use
+            if (ftruncate(fd, used) != 0) {
+                flog::warn("could not trim spot journal {0}: {1}", path, strerror(errno));
+            }
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        map = NULL;
+        fd = -1;
+        capacity = 0;
+        used = 0;
+        spotRecords = 0;
+        stringRecords = 0;
+        tailRecords = 0;
+        poolOffset = 0;
+        poolEnds.clear();
+        snapshotOffset = 0;
+        snapshotSpots = 0;
+        tailOffset = headerSize;
+        fileSources.clear();
+        fileStrings.clear();
+        for (auto& source : sources) {
+            source.fileId = -1;
+        }
+        writtenStrings.clear();
+        writtenPool.reset();
+    }
+
+    bool isOpen() const { return map != NULL; }
+
+    // put spots from the journal spotted at or after since into store.
+    // only once per open(), right after it. the caller publishes
+    // returns how many spots it put in or updated
+    size_t replay(SpotStore& store, SpotTime since) {
+        if (!map) { return 0; }
+        uint32_t sinceSeconds = SpotStore::toSeconds(since);
+
+        // file string ids to store string ids, interned as they're needed
+        std::vector<uint32_t> storeIds(fileStrings.size(), UINT32_MAX);
+        size_t loaded = 0;
+        if (poolOffset && store.loadStrings(map + poolOffset, poolEnds)) {
+            // the snapshot's strings kept their ids
+            loaded = poolEnds.size();
+            for (uint32_t id = 0; id < loaded; id++) { storeIds[id] = id; }
+        }
+        if (stringRecords > loaded) {
+            store.reserveStrings(stringRecords - loaded);
+        }
+        auto intern = [&](uint32_t id) -> uint32_t {
+            if (id >= storeIds.size()) { return 0; }
+            if (storeIds[id] == UINT32_MAX) {
+                storeIds[id] = store.intern(fileStrings[id]);
+            }
+            return storeIds[id];
+        };
+        auto internRest = [&](SpotRecord& record) {
+            record.spotters[0] = intern(record.spotters[0]);
+            record.comment = intern(record.comment);
+            record.location = intern(record.location);
+        };
+
+        size_t count = 0;
+        if (snapshotOffset) {
+            std::vector<SpotRecord> spots;
+            spots.reserve(snapshotSpots);
+            const char* p = map + snapshotOffset + recordHeader;
+            for (size_t i = 0; i < snapshotSpots; i++, p += spotPayload) {
+                SpotRecord record;
+                if (!readSpot(p, sinceSeconds, &record)) { continue; }
+                record.label = intern(record.label);
+                internRest(record);
+                spots.push_back(record);
+            }
+            count += store.load(std::move(spots));
+        }
+
+        // then what changed after it. only the last record for each label
+        // and band between erasures counts, anything it replaced was older
+        std::vector<SpotRecord> records;
+        std::unordered_map<uint64_t, uint32_t> latest;
+        records.reserve(spotRecords);
+        latest.reserve(spotRecords);
+        auto flush = [&]() {
+            std::vector<SpotRecord> batch;
+            batch.reserve(records.size());
+            for (SpotRecord& record : records) {
+                if (!record.source) { continue; }
+                internRest(record);
+                batch.push_back(record);
+            }
+            count += store.merge(std::move(batch));
+            records.clear();
+            latest.clear();
+        };
+        for (size_t offset = tailOffset; offset < used; offset += recordSize(offset)) {
+            const char* p = map + offset + recordHeader;
+            uint8_t type = map[offset + 4];
+            if (type == RECORD_SPOT) {
+                SpotRecord record;
+                if (!readSpot(p, sinceSeconds, &record)) { continue; }
+                // the rest stay file ids until we know the record survives
+                record.label = intern(record.label);
+                auto previous = latest.emplace(SpotStore::key(record.label, record.frequency), records.size());
+                if (!previous.second) {
+                    records[previous.first->second].source = NULL;
+                    previous.first->second = records.size();
+                }
+                records.push_back(record);
+            } else if (type == RECORD_CLEAR) {
+                flush();
+                uint8_t fileSource = (uint8_t)p[0];
+                if (fileSource < fileSources.size() && fileSources[fileSource] >= 0) {
+                    store.eraseSource(sources[fileSources[fileSource]].source);
+                }
+            } else if (type == RECORD_EXPIRE) {
+                flush();
+                store.expire(SpotTime(std::chrono::seconds(get<uint32_t>(p))));
+            }
+        }
+        flush();
+
+        // the strings we just interned are in the file already, so
+        // appending their spots again doesn't write them a second time
+        writtenPool = store.stringPool();
+        writtenStrings.assign(writtenPool->size(), UINT32_MAX);
+        for (uint32_t id = 0; id < storeIds.size(); id++) {
+            if (storeIds[id] != UINT32_MAX) {
+                writtenStrings[storeIds[id]] = id;
+            }
+        }
+
+        // only needed until the first replay
+        fileStrings = std::vector<std::string_view>();
+        poolEnds = std::vector<uint32_t>();
+        return count;
+    }
+
+    // write the records of spots that changed store
+    void append(const std::vector<SpotRecord>& records, const SpotStore& store) {
+        if (!map || records.empty()) { return; }
+        std::shared_ptr<const StringPool> pool = store.stringPool();
+        if (pool != writtenPool) {
+            // string ids from the old pool mean nothing in the new one
+            writtenStrings.clear();
+            writtenPool = pool;
+        }
+
+        for (const SpotRecord& record : records) {
+            if (!appendSpot(record)) {
+                flog::error("could not grow spot journal {0}, closing it", path);
+                close();
+                return;
+            }
+        }
+        commit();
+    }
+
+    // the store forgot everything source reported, recredited are the
+    // spots it kept that source had the latest report of
+    void eraseSource(const SpotSource* source, const std::vector<SpotRecord>& recredited, const SpotStore& store) {
+        if (!map) { return; }
+        int id = -1;
+        for (auto& s : sources) {
+            if (s.source == source) { id = s.fileId; }
+        }
+        // nothing of it in the file to forget
+        if (id < 0) { return; }
+        char* p = appendRecord(RECORD_CLEAR, 1);
+        if (!p) {
+            flog::error("could not grow spot journal {0}, closing it", path);
+            close();
+            return;
+        }
+        p[0] = (char)id;
+        tailRecords++;
+        commit();
+        // the clear takes them too, put them back under their new source
+        append(recredited, store);
+    }
+
+    // the store dropped every spot from before expirationTime
+    void expire(SpotTime expirationTime) {
+        if (!map) { return; }
+        char* p = appendRecord(RECORD_EXPIRE, 4);
+        if (!p) {
+            flog::error("could not grow spot journal {0}, closing it", path);
+            close();
+            return;
+        }
+        put<uint32_t>(p, SpotStore::toSeconds(expirationTime));
+        tailRecords++;
+        commit();
+    }
+
+    // what's been appended since the last snapshot is enough to slow a
+    // restart down, replaying a record costs several times what loading
+    // a snapshot spot does
+    bool wantsCompaction(size_t liveSpots) const {
+        return map && tailRecords > liveSpots / 8 + 4096;
+    }
+
+    // rewrite the journal as a snapshot of store
+    bool compact(SpotStore& store) {
+        if (!map) { return false; }
+        size_t before = used;
+        close();
+
+        std::string tmpPath = path + ".tmp";
+        unlink(tmpPath.c_str());
+        bool ok = mapFile(tmpPath) && reset() && writeSnapshot(store) && sync();
+        if (ok && rename(tmpPath.c_str(), path.c_str()) != 0) {
+            flog::error("could not replace spot journal {0}: {1}", path, strerror(errno));
+            ok = false;
+        }
+        if (ok) {
+            syncDir();
+        }
+        if (!ok) {
+            // the old journal is still there and still good
+            close();
+            unlink(tmpPath.c_str());
+            return open(path);
+        }
+        flog::info("compacted spot journal from {0} to {1} bytes", before, used);
+        return true;
+    }
+
+    // committed size of the file
+    size_t bytes() const { return used; }
+
+private:
+    enum RecordType {
+        RECORD_SOURCE = 1,
+        RECORD_STRING = 2,
+        RECORD_SPOT = 3,
+        RECORD_STRINGS = 4,
+        RECORD_SNAPSHOT = 5,
+        RECORD_CLEAR = 6,
+        RECORD_EXPIRE = 7
+    };
+
+    struct Source {
+        SpotSource* source;
+        std::string name;
+        int fileId; // -1 until it's in the file
+    };
+
+    static constexpr char magic[8] = {'S', 'P', 'O', 'T', 'J', 'N', 'L', '1'};
+    static constexpr size_t headerSize = 32;
+    static constexpr size_t usedOffset = 8;
+    static constexpr size_t recordHeader = 5;
+    static constexpr size_t spotPayload = 29;
+    static constexpr size_t spotSize = recordHeader + spotPayload;
+    static constexpr size_t growBy = 1 << 20;
+    static constexpr size_t maxSources = 256;
+
+    template <typename T>
+    static T get(const char* p) {
+        T value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    template <typename T>
+    static void put(char* p, T value) {
+        memcpy(p, &value, sizeof(value));
+    }
+
+    size_t recordSize(size_t offset) const {
+        return get<uint32_t>(map + offset);
+    }
+
+    // a spot record's payload, or a snapshot entry. strings are left as
+    // file ids. false if it's older than since or from a source we don't
+    // have
+    bool readSpot(const char* p, uint32_t since, SpotRecord* record) const {
+        uint8_t fileSource = (uint8_t)p[0];
+        *record = {};
+        record->frequency = get<int64_t>(p + 1);
+        record->spotTime = get<uint32_t>(p + 9);
+        if (record->spotTime < since || fileSource >= fileSources.size() || fileSources[fileSource] < 0) {
+            return false;
+        }
+        record->source = sources[fileSources[fileSource]].source;
+        record->label = get<uint32_t>(p + 13);
+        record->spotters[0] = get<uint32_t>(p + 17);
+        record->comment = get<uint32_t>(p + 21);
+        record->location = get<uint32_t>(p + 25);
+        return true;
+    }
+
+    static void writeSpot(char* p, int source, const SpotRecord& record, uint32_t label, uint32_t spotter, uint32_t comment, uint32_t location) {
+        p[0] = (char)source;
+        put<int64_t>(p + 1, record.frequency);
+        put<uint32_t>(p + 9, record.spotTime);
+        put<uint32_t>(p + 13, label);
+        put<uint32_t>(p + 17, spotter);
+        put<uint32_t>(p + 21, comment);
+        put<uint32_t>(p + 25, location);
+    }
+
+    bool mapFile(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            flog::error("could not open spot journal {0}: {1}", path, strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            flog::error("could not stat spot journal {0}: {1}", path, strerror(errno));
+            return false;
+        }
+        return remap(std::max((size_t)st.st_size, growBy));
+    }
+
+    bool remap(size_t size) {
+        if (map) {
+            munmap(map, capacity);
+            map = NULL;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || ((size_t)st.st_size < size && ftruncate(fd, size) != 0)) {
+            flog::error("could not size spot journal {0}: {1}", path, strerror(errno));
+            return false;
+        }
+        void* m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) {
+            flog::error("could not map spot journal {0}: {1}", path, strerror(errno));
+            return false;
+        }
+        map = (char*)m;
+        capacity = size;
+        return true;
+    }
+
+    // start an empty journal in the mapped file
+    bool reset() {
+        memset(map, 0, headerSize);
+        memcpy(map, magic, sizeof(magic));
+        used = headerSize;
+        spotRecords = 0;
+        stringRecords = 0;
+        tailRecords = 0;
+        snapshotOffset = 0;
+        snapshotSpots = 0;
+        tailOffset = headerSize;
+        fileSources.clear();
+        fileStrings.clear();
+        commit();
+        return true;
+    }
+
+    // the strings and spots of store, see compact(). on a fresh file
+    bool writeSnapshot(SpotStore& store) {
+        // strings in the order the spots first use them, the empty one
+        // first
+        writtenPool = store.stringPool();
+        writtenStrings.assign(writtenPool->size(), UINT32_MAX);
+        writtenStrings[0] = 0;
+        std::vector<uint32_t> ends(1, 0);
+        std::string bytes;
+        auto imageId = [&](uint32_t id) {
+            if (writtenStrings[id] == UINT32_MAX) {
+                bytes.append(writtenPool->get(id));
+                writtenStrings[id] = ends.size();
+                ends.push_back(bytes.size());
+            }
+            return writtenStrings[id];
+        };
+
+        std::vector<char> spots;
+        spots.reserve(store.size() * spotPayload);
+        size_t count = 0;
+        char entry[spotPayload];
+        for (auto it = store.begin(); it != store.end(); ++it) {
+            int source = sourceId(it->source);
+            if (source == -1) { continue; } // not ours to keep
+            if (source < 0) { return false; }
+            writeSpot(entry, source, *it, imageId(it->label), imageId(it->spotter()), imageId(it->comment), imageId(it->location));
+            spots.insert(spots.end(), entry, entry + spotPayload);
+            count++;
+        }
+
+        size_t endsSize = ends.size() * sizeof(uint32_t);
+        char* p = appendRecord(RECORD_STRINGS, 4 + endsSize + bytes.size());
+        if (!p) { return false; }
+        put<uint32_t>(p, ends.size());
+        memcpy(p + 4, ends.data(), endsSize);
+        memcpy(p + 4 + endsSize, bytes.data(), bytes.size());
+        stringRecords = ends.size();
+
+        p = appendRecord(RECORD_SNAPSHOT, spots.size());
+        if (!p) { return false; }
+        memcpy(p, spots.data(), spots.size());
+        snapshotSpots = count;
+        commit();
+        return true;
+    }
+
+    // get what's committed onto the disk
+    bool sync() {
+        if (msync(map, used, MS_SYNC) != 0 || fsync(fd) != 0) {
+            flog::error("could not sync spot journal {0}: {1}", path, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // and the rename of it
+    void syncDir() {
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, std::max<size_t>(slash, 1));
+        int dirFd = ::open(dir.c_str(), O_RDONLY);
+        if (dirFd < 0) { return; }
+        if (fsync(dirFd) != 0) {
+            flog::warn("could not sync {0}: {1}", dir, strerror(errno));
+        }
+        ::close(dirFd);
+    }
+
+    // check the records and read back the source and string tables
+    // a torn or corrupt tail is dropped
+    bool scan() {
+        if (memcmp(map, magic, sizeof(magic)) != 0) { return false; }
+        size_t committed = get<uint64_t>(map + usedOffset);
+        if (committed < headerSize || committed > capacity) { return false; }
+
+        size_t offset = headerSize;
+        while (offset + recordHeader <= committed) {
+            size_t size = recordSize(offset);
+            if (size < recordHeader || size > committed - offset) { break; }
+            uint8_t type = map[offset + 4];
+            if (type == RECORD_SOURCE) {
+                std::string_view name(map + offset + recordHeader, size - recordHeader);
+                fileSources.push_back(-1);
+                for (size_t i = 0; i < sources.size(); i++) {
+                    if (sources[i].name == name) {
+                        sources[i].fileId = fileSources.size() - 1;
+                        fileSources.back() = i;
+                    }
+                }
+            } else if (type == RECORD_STRING) {
+                fileStrings.push_back(std::string_view(map + offset + recordHeader, size - recordHeader));
+                stringRecords++;
+                tailRecords++;
+            } else if (type == RECORD_SPOT && size == spotSize) {
+                spotRecords++;
+                tailRecords++;
+            } else if (type == RECORD_STRINGS && fileStrings.empty() && scanStrings(offset, size)) {
+                // ids start at 0, only a snapshot has one, first
+            } else if (type == RECORD_SNAPSHOT && snapshotOffset == 0 && (size - recordHeader) % spotPayload == 0) {
+                snapshotOffset = offset;
+                snapshotSpots = (size - recordHeader) / spotPayload;
+                // the rest is replayed record by record
+                tailOffset = offset + size;
+                spotRecords = 0;
+                tailRecords = 0;
+            } else if ((type == RECORD_CLEAR && size == recordHeader + 1) || (type == RECORD_EXPIRE && size == recordHeader + 4)) {
+                tailRecords++;
+            } else {
+                break;
+            }
+            offset += size;
+        }
+        if (offset != committed) {
+            flog::warn("dropping {0} bytes of unreadable spot journal", committed - offset);
+        }
+        used = offset;
+        commit();
+        return true;
+    }
+
+    // read back a strings record's table, false if it doesn't add up
+    bool scanStrings(size_t offset, size_t size) {
+        const char* p = map + offset + recordHeader;
+        size_t payload = size - recordHeader;
+        if (payload < 4) { return false; }
+        size_t count = get<uint32_t>(p);
+        if (count == 0 || count > (payload - 4) / 4) { return false; }
+        const char* bytes = p + 4 + count * 4;
+        size_t length = payload - 4 - count * 4;
+        std::vector<uint32_t> ends(count);
+        memcpy(ends.data(), p + 4, count * 4);
+        if (ends[0] != 0 || ends.back() != length) { return false; }
+        for (size_t i = 1; i < count; i++) {
+            if (ends[i] < ends[i - 1]) { return false; }
+        }
+        fileStrings.reserve(count);
+        fileStrings.push_back(std::string_view());
+        for (size_t i = 1; i < count; i++) {
+            fileStrings.push_back(std::string_view(bytes + ends[i - 1], ends[i] - ends[i - 1]));
+        }
+        stringRecords = count;
+        poolOffset = bytes - map;
+        poolEnds = std::move(ends);
+        return true;
+    }
+
+    // room for size more bytes at the end, growing the file if needed
+    char* claim(size_t size) {
+        if (used + size > capacity && !remap(std::max(capacity * 2, used + size + growBy))) {
+            return NULL;
+        }
+        char* p = map + used;
+        used += size;
+        return p;
+    }
+
+    char* appendRecord(RecordType type, size_t payload) {
+        char* p = claim(recordHeader + payload);
+        if (!p) { return NULL; }
+        put<uint32_t>(p, recordHeader + payload);
+        p[4] = type;
+        return p + recordHeader;
+    }
+
+    // file id of a source, writing its record if it's new to the file
+    int sourceId(const SpotSource* source) {
+        for (auto& s : sources) {
+            if (s.source != source) { continue; }
+            if (s.fileId < 0 && fileSources.size() < maxSources) {
+                char* p = appendRecord(RECORD_SOURCE, s.name.size());
+                if (!p) { return -2; }
+                memcpy(p, s.name.data(), s.name.size());
+                s.fileId = fileSources.size();
+                fileSources.push_back(&s - sources.data());
+            }
+            return s.fileId;
+        }
+        return -1;
+    }
+
+    // file id of a string in writtenPool, writing it if it's new to the
+    // file
+    bool stringId(uint32_t id, uint32_t* fileId) {
+        if (id >= writtenStrings.size()) {
+            writtenStrings.resize(writtenPool->size(), UINT32_MAX);
+        }
+        if (writtenStrings[id] == UINT32_MAX) {
+            std::string_view s = writtenPool->get(id);
+            char* p = appendRecord(RECORD_STRING, s.size());
+            if (!p) { return false; }
+            memcpy(p, s.data(), s.size());
+            writtenStrings[id] = stringRecords++;
+            tailRecords++;
+        }
+        *fileId = writtenStrings[id];
+        return true;
+    }
+
+    bool appendSpot(const SpotRecord& record) {
+        int source = sourceId(record.source);
+        if (source == -1) { return true; } // not ours to keep
+        uint32_t label, spotter, comment, location;
+        if (source < 0 || !stringId(record.label, &label) || !stringId(record.spotter(), &spotter) ||
+                !stringId(record.comment, &comment) || !stringId(record.location, &location)) {
+            return false;
+        }
+        char* p = appendRecord(RECORD_SPOT, spotPayload);
+        if (!p) { return false; }
+        writeSpot(p, source, record, label, spotter, comment, location);
+        spotRecords++;
+        tailRecords++;
+        return true;
+    }
+
+    // make everything appended so far part of the journal
+    void commit() {
+        put<uint64_t>(map + usedOffset, used);
+    }
+
+    std::string path;
+    std::vector<Source> sources;
+
+    int fd = -1;
+    char* map = NULL;
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t spotRecords = 0;   // after the snapshot
+    size_t stringRecords = 0; // the next string id
+    size_t tailRecords = 0;   // anything replay() goes through one by one
+
+    // the snapshot, if there is one. poolOffset is where its string bytes
+    // start and poolEnds where each string ends. tailOffset is the first
+    // record after it
+    size_t poolOffset = 0;
+    std::vector<uint32_t> poolEnds;
+    size_t snapshotOffset = 0;
+    size_t snapshotSpots = 0;
+    size_t tailOffset = headerSize;
+
+    // what the file's ids refer to, fileSources is an index in sources
+    // (-1 for sources we don't have) and fileStrings points into the map
+    std::vector<int> fileSources;
+    std::vector<std::string_view> fileStrings;
+
+    // file ids of strings already written, by id in writtenPool
+    std::vector<uint32_t> writtenStrings;
+    std::shared_ptr<const StringPool> writtenPool;
+};
+
+#endif //__SDRPP_SPOTS_SPOT_JOURNAL_H
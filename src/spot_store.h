@@ -0,0 +1,636 @@
+#ifndef __SDRPP_SPOTS_SPOT_STORE_H
+#define __SDRPP_SPOTS_SPOT_STORE_H
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include "main.h"
+#include "string_pool.h"
+
+struct SpotSource;
+
+// a spot as the store keeps it, strings are ids in the snapshot's pool
+// there's one per callsign and band, however many sources and spotters
+// reported it. everything but sources and spotters is from the latest
+// report
+struct SpotRecord {
+    static constexpr size_t maxSpotters = 4;
+
+    int64_t frequency;   // Hz
+    SpotSource* source;
+    uint32_t spotTime;   // seconds since the unix epoch
+    uint32_t label;
+    uint32_t comment;
+    uint32_t location;
+    uint32_t sources;    // a bit per store source id that reported it
+    uint32_t spotters[maxSpotters]; // most recent first
+    uint8_t spotterCount;
+
+    uint32_t spotter() const { return spotters[0]; }
+
+    bool reportedBy(uint32_t sourceId) const { return sourceId < 32 && (sources >> sourceId) & 1; }
+
+    std::chrono::time_point<std::chrono::system_clock> time() const {
+        return std::chrono::time_point<std::chrono::system_clock>(std::chrono::seconds(spotTime));
+    }
+};
+
+// an immutable, frequency ordered view of the store
+// readers get one from SpotStore::current() and can hold on to it (and
+// pointers to the records in it) as long as they like without any
+// locking
+struct SpotSnapshot {
+    typedef std::vector<SpotRecord>::const_iterator const_iterator;
+
+    // first spot at or above frequency
+    const_iterator lowerBound(double frequency) const {
+        return std::lower_bound(spots.begin(), spots.end(), frequency,
+                [](const SpotRecord& s, double f) { return s.frequency < f; });
+    }
+
+    // first spot above frequency
+    const_iterator upperBound(double frequency) const {
+        return std::upper_bound(spots.begin(), spots.end(), frequency,
+                [](double f, const SpotRecord& s) { return f < s.frequency; });
+    }
+
+    std::string_view str(uint32_t id) const { return strings->get(id); }
+
+    // the whole spot, for when we need more than a label
+    Spot spot(const SpotRecord& r) const {
+        return {
+            std::string(str(r.label)),
+            std::string(str(r.spotter())),
+            (double)r.frequency,
+            r.time(),
+            std::string(str(r.comment)),
+            std::string(str(r.location))
+        };
+    }
+
+    uint64_t version = 0;
+    std::vector<SpotRecord> spots;
+    std::shared_ptr<const StringPool> strings;
+    // by store source id, for SpotRecord::sources
+    std::vector<SpotSource*> sources;
+};
+
+/**********************************************
+ * Spots we're keeping track of, indexed three ways:
+ * 1. by label (callsign) and band in a hash map, for de-dup
+ * 2. by frequency in an ordered index, for drawing
+ * 3. by spot time in a min-heap, for expiration
+ *
+ * A station on two bands is two spots, but every report of it on one
+ * band, from any source or spotter, goes to the same spot: the latest
+ * report's details win, and the spot remembers which sources and which
+ * (few, recent) spotters reported it. Sources get a store id, and a bit
+ * in SpotRecord::sources, as they're first seen, up to 32 of them.
+ *
+ * Spots are kept as compact SpotRecords: strings are interned in a
+ * StringPool shared with the snapshots, frequency is integer Hz and the
+ * time 32 bit seconds. The pool only grows, so once it's mostly strings
+ * no live spot uses publish() starts a fresh one; snapshots keep the old
+ * one alive as long as they need it.
+ *
+ * Writers must serialize access with their own lock and call publish()
+ * after a round of changes. Readers only ever call current(), which is
+ * safe from any thread without that lock.
+ **********************************************/
+class SpotStore {
+private:
+    typedef std::pair<int64_t, uint32_t> FreqKey;
+    typedef std::set<FreqKey> FreqIndex;
+    typedef uint64_t SpotKey; // label id and band
+    typedef std::chrono::time_point<std::chrono::system_clock> TimePoint;
+
+    // heap entries are never removed when a spot is updated or erased,
+    // instead they're skipped on pop if the slot has moved on
+    struct ExpiryKey {
+        uint32_t spotTime;
+        uint32_t slot;
+        uint32_t generation;
+        bool operator>(const ExpiryKey& rhs) const { return spotTime > rhs.spotTime; }
+    };
+
+public:
+    SpotStore() : strings(std::make_shared<StringPool>()) {
+        auto empty = std::make_shared<SpotSnapshot>();
+        empty->strings = strings;
+        published = std::move(empty);
+    }
+
+    static constexpr uint32_t maxSources = 32;
+
+    // the source's store id, giving it the next one if it's new. add
+    // sources up front to pick their ids, sources past maxSources share
+    // the last bit
+    uint32_t addSource(SpotSource* source) {
+        if (source == lastSource) { return lastSourceId; }
+        uint32_t id = 0;
+        while (id < sources.size() && sources[id] != source) { id++; }
+        if (id == sources.size()) {
+            if (id == maxSources) {
+                return maxSources - 1;
+            }
+            sources.push_back(source);
+        }
+        lastSource = source;
+        lastSourceId = id;
+        return id;
+    }
+
+    // amateur bands get one each, anywhere else is split by the MHz so
+    // spots of, say, broadcast stations on different frequencies stay
+    // apart
+    static uint32_t band(int64_t frequency) {
+        static constexpr int64_t edges[][2] = {
+            {135700, 137800}, {472000, 479000}, {1800000, 2000000}, {3500000, 4000000},
+            {5250000, 5450000}, {7000000, 7300000}, {10100000, 10150000}, {14000000, 14350000},
+            {18068000, 18168000}, {21000000, 21450000}, {24890000, 24990000}, {28000000, 29700000},
+            {50000000, 54000000}, {70000000, 71000000}, {144000000, 148000000}, {222000000, 225000000},
+            {420000000, 450000000}, {902000000, 928000000}, {1240000000, 1300000000}
+        };
+        constexpr size_t bands = sizeof(edges) / sizeof(edges[0]);
+        size_t i = std::upper_bound(edges, edges + bands, frequency,
+                [](int64_t f, const int64_t* e) { return f < e[0]; }) - edges;
+        if (i > 0 && frequency <= edges[i - 1][1]) {
+            return i;
+        }
+        return bands + 1 + (uint32_t)std::clamp<int64_t>(frequency / 1000000, 0, UINT32_MAX - bands - 1);
+    }
+
+    // what spots are de-duplicated on
+    static SpotKey key(uint32_t label, int64_t frequency) {
+        return ((SpotKey)label << 32) | band(frequency);
+    }
+
+    // iterates spots in frequency order
+    class iterator {
+    public:
+        iterator(std::vector<SpotRecord>* s, FreqIndex::const_iterator i) : slots(s), it(i) {}
+
+        const SpotRecord& operator*() const { return (*slots)[it->second]; }
+        const SpotRecord* operator->() const { return &(*slots)[it->second]; }
+        iterator& operator++() { ++it; return *this; }
+        bool operator==(const iterator& rhs) const { return it == rhs.it; }
+        bool operator!=(const iterator& rhs) const { return it != rhs.it; }
+
+    private:
+        friend class SpotStore;
+        std::vector<SpotRecord>* slots;
+        FreqIndex::const_iterator it;
+    };
+
+    iterator begin() { return iterator(&slots, freqIndex.begin()); }
+    iterator end() { return iterator(&slots, freqIndex.end()); }
+
+    size_t size() const { return keyIndex.size(); }
+    bool empty() const { return keyIndex.empty(); }
+
+    // heap bytes held, for benchmarks. vectors count by capacity, the
+    // hash and ordered indexes are estimated from their node and bucket
+    // counts, the heap from its entries, stale ones included
+    struct Memory {
+        size_t stringPages;
+        size_t stringBlocks;
+        size_t stringIndex;
+        size_t slots;       // records, live bits, generations and free list
+        size_t keyIndex;
+        size_t freqIndex;
+        size_t expiryHeap;
+        size_t snapshot;    // the published snapshot's records
+
+        size_t total() const {
+            return stringPages + stringBlocks + stringIndex + slots + keyIndex + freqIndex + expiryHeap + snapshot;
+        }
+    };
+
+    Memory memory() const {
+        Memory m;
+        m.stringPages = strings->pageBytes();
+        m.stringBlocks = strings->blockBytes();
+        m.stringIndex = strings->indexBytes();
+        m.slots = slots.capacity() * sizeof(SpotRecord) + live.capacity() / 8 +
+            generations.capacity() * sizeof(uint32_t) + freeSlots.capacity() * sizeof(uint32_t);
+        // next pointer and entry, the hash of an integer isn't cached
+        m.keyIndex = keyIndex.size() * (sizeof(void*) + sizeof(decltype(keyIndex)::value_type)) +
+            keyIndex.bucket_count() * sizeof(void*);
+        // color and three links, then the key
+        m.freqIndex = freqIndex.size() * (4 * sizeof(void*) + sizeof(FreqKey));
+        m.expiryHeap = expiryHeap.size() * sizeof(ExpiryKey);
+        m.snapshot = published->spots.capacity() * sizeof(SpotRecord);
+        return m;
+    }
+
+    // for strings of records from begin()/end()
+    std::string_view str(uint32_t id) const { return strings->get(id); }
+
+    // the pool str() reads from, replaced when publish() compacts it
+    std::shared_ptr<const StringPool> stringPool() const { return strings; }
+
+    // for building records outside the store, see merge()
+    uint32_t intern(std::string_view s) { return strings->intern(s); }
+
+    // room for n more spots, or strings, ahead of a bulk merge
+    void reserve(size_t n) {
+        keyIndex.reserve(keyIndex.size() + n);
+        slots.reserve(slots.size() + n);
+        live.reserve(live.size() + n);
+        generations.reserve(generations.size() + n);
+    }
+    void reserveStrings(size_t n) { strings->reserve(n); }
+
+    // an empty store's strings all at once, see StringPool::load()
+    bool loadStrings(const char* data, const std::vector<uint32_t>& ends) { return strings->load(data, ends); }
+
+    // fill an empty store with spots already in frequency order, one per
+    // label and band, like a journal snapshot. much cheaper than merge(),
+    // which it falls back to if the store isn't empty
+    // returns how many spots were loaded
+    size_t load(std::vector<SpotRecord>&& sorted) {
+        if (!keyIndex.empty() || !slots.empty()) {
+            return merge(std::move(sorted));
+        }
+        reserve(sorted.size());
+        std::vector<ExpiryKey> expiring;
+        expiring.reserve(sorted.size());
+        for (const SpotRecord& spot : sorted) {
+            uint32_t slot = slots.size();
+            if (!keyIndex.emplace(key(spot.label, spot.frequency), slot).second) { continue; }
+            slots.push_back(spot);
+            slots.back().sources = 1u << addSource(spot.source);
+            slots.back().spotterCount = 1;
+            live.push_back(true);
+            generations.push_back(0);
+            freqIndex.emplace_hint(freqIndex.end(), spot.frequency, slot);
+            expiring.push_back({spot.spotTime, slot, 0});
+        }
+        // heapify in one go
+        expiryHeap = ExpiryHeap(std::greater<ExpiryKey>(), std::move(expiring));
+        sorted.clear();
+        return slots.size();
+    }
+
+    // insert a spot, or update the spot with the same label on the same
+    // band. the more recent spot takes precedence, an older one only adds
+    // its source and spotter
+    // returns true if the store changed
+    bool upsert(const Spot& spot, SpotSource* source) {
+        FreqIndex::const_iterator hint = freqIndex.end();
+        uint32_t slot;
+        return upsert(makeRecord(spot, source), hint, &slot);
+    }
+
+    // upsert a whole batch of spots from one source, taking ownership
+    // the spots that changed the store go in changed, if given, as they
+    // are stored now
+    // returns how many spots changed the store
+    size_t merge(std::vector<Spot>&& batch, SpotSource* source, std::vector<SpotRecord>* changed = NULL) {
+        std::vector<SpotRecord> records;
+        records.reserve(batch.size());
+        for (const Spot& spot : batch) {
+            records.push_back(makeRecord(spot, source));
+        }
+        batch.clear();
+        return merge(std::move(records), changed);
+    }
+
+    // same, for records whose strings came from intern()
+    // only source and spotters[0] of the records' sources and spotters
+    // are used
+    // the batch is walked in frequency order so new spots mostly land
+    // right after the previous one in the frequency index instead of each
+    // needing its own search
+    size_t merge(std::vector<SpotRecord>&& batch, std::vector<SpotRecord>* changed = NULL) {
+        std::sort(batch.begin(), batch.end(), [](const SpotRecord& a, const SpotRecord& b) { return a.frequency < b.frequency; });
+
+        size_t count = 0;
+        FreqIndex::const_iterator hint = freqIndex.begin();
+        uint32_t slot;
+        for (const SpotRecord& record : batch) {
+            if (upsert(record, hint, &slot)) {
+                count++;
+                if (changed) { changed->push_back(slots[slot]); }
+            }
+        }
+        batch.clear();
+        return count;
+    }
+
+    // erase the spot for label on frequency's band
+    bool erase(std::string_view label, int64_t frequency) {
+        uint32_t id;
+        if (!strings->find(label, &id)) {
+            return false;
+        }
+        auto existing = keyIndex.find(key(id, frequency));
+        if (existing == keyIndex.end()) {
+            return false;
+        }
+        uint32_t slot = existing->second;
+        freqIndex.erase(FreqKey(slots[slot].frequency, slot));
+        keyIndex.erase(existing);
+        freeSlot(slot);
+        return true;
+    }
+
+    // erase and get the next spot in frequency order
+    iterator erase(iterator pos) {
+        uint32_t slot = pos.it->second;
+        keyIndex.erase(key(slots[slot].label, slots[slot].frequency));
+        auto next = freqIndex.erase(pos.it);
+        freeSlot(slot);
+        return iterator(&slots, next);
+    }
+
+    // forget everything source reported: spots only it reported are
+    // erased, the rest just lose its bit. a spot whose latest report was
+    // source's keeps that report, credited to another of its sources,
+    // and goes in recredited if given
+    size_t eraseSource(SpotSource* source, std::vector<SpotRecord>* recredited = NULL) {
+        uint32_t id = addSource(source);
+        uint32_t bit = 1u << id;
+        size_t count = 0;
+        for (auto it = begin(); it != end();) {
+            SpotRecord& spot = slots[it.it->second];
+            if (!(spot.sources & bit)) {
+                ++it;
+                continue;
+            }
+            spot.sources &= ~bit;
+            if (spot.sources == 0) {
+                it = erase(it);
+                count++;
+                continue;
+            }
+            if (spot.source == source) {
+                spot.source = sources[ctz(spot.sources)];
+                if (recredited) { recredited->push_back(spot); }
+            }
+            ++it;
+        }
+        return count;
+    }
+
+    template <typename Pred>
+    size_t eraseIf(Pred pred) {
+        size_t count = 0;
+        for (auto it = begin(); it != end();) {
+            if (pred(*it)) {
+                it = erase(it);
+                count++;
+            } else {
+                ++it;
+            }
+        }
+        return count;
+    }
+
+    // erase every spot spotted before expirationTime
+    // cost is proportional to the number of expired (and stale) heap
+    // entries, not the size of the store
+    // if expired isn't NULL, the erased spots are appended to it
+    size_t expire(TimePoint expirationTime, std::vector<SpotRecord>* expired = NULL) {
+        uint32_t expiration = toSeconds(expirationTime);
+        size_t count = 0;
+        while (!expiryHeap.empty() && expiryHeap.top().spotTime < expiration) {
+            ExpiryKey key = expiryHeap.top();
+            expiryHeap.pop();
+            if (generations[key.slot] != key.generation || !live[key.slot] || slots[key.slot].spotTime != key.spotTime) {
+                // slot was erased or the spot was updated since
+                continue;
+            }
+            const SpotRecord& stored = slots[key.slot];
+            if (expired) { expired->push_back(stored); }
+            freqIndex.erase(FreqKey(stored.frequency, key.slot));
+            keyIndex.erase(SpotStore::key(stored.label, stored.frequency));
+            freeSlot(key.slot);
+            count++;
+        }
+        return count;
+    }
+
+    void clear() {
+        keyIndex.clear();
+        freqIndex.clear();
+        slots.clear();
+        live.clear();
+        generations.clear();
+        freeSlots.clear();
+        expiryHeap = ExpiryHeap();
+        strings = std::make_shared<StringPool>();
+    }
+
+    // make the current state of the store visible to readers
+    // this copies the records, which are small, the strings are shared
+    void publish() {
+        if (strings->size() > 8 * keyIndex.size() + 65536) {
+            compactStrings();
+        }
+        auto snapshot = std::make_shared<SpotSnapshot>();
+        snapshot->version = ++version;
+        snapshot->strings = strings;
+        snapshot->sources = sources;
+        snapshot->spots.reserve(freqIndex.size());
+        for (const auto& key : freqIndex) {
+            snapshot->spots.push_back(slots[key.second]);
+        }
+        std::atomic_store(&published, std::shared_ptr<const SpotSnapshot>(std::move(snapshot)));
+    }
+
+    // the most recently published snapshot, safe to call from any thread
+    std::shared_ptr<const SpotSnapshot> current() const {
+        return std::atomic_load(&published);
+    }
+
+    // a time as SpotRecord keeps it
+    static uint32_t toSeconds(TimePoint t) {
+        int64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch()).count();
+        return (uint32_t)std::clamp<int64_t>(seconds, 0, UINT32_MAX);
+    }
+
+private:
+
+    SpotRecord makeRecord(const Spot& spot, SpotSource* source) {
+        SpotRecord record = {};
+        record.frequency = std::llround(spot.frequency);
+        record.source = source;
+        record.spotTime = toSeconds(spot.spotTime);
+        record.label = strings->intern(spot.label);
+        record.comment = strings->intern(spot.comment);
+        record.location = strings->intern(spot.location);
+        record.spotters[0] = strings->intern(spot.spotter);
+        return record;
+    }
+
+    static bool sameSpot(const SpotRecord& a, const SpotRecord& b) {
+        return a.source == b.source &&
+            a.spotTime == b.spotTime &&
+            a.frequency == b.frequency &&
+            a.spotter() == b.spotter() &&
+            a.comment == b.comment &&
+            a.location == b.location;
+    }
+
+    static uint32_t ctz(uint32_t bits) {
+        uint32_t i = 0;
+        while (!(bits & 1)) { bits >>= 1; i++; }
+        return i;
+    }
+
+    // the latest report's spotter goes first, an older report's only
+    // goes on the end if there's room
+    // returns true if the list changed
+    static bool addSpotter(SpotRecord& record, uint32_t spotter, bool latest) {
+        size_t i = 0;
+        while (i < record.spotterCount && record.spotters[i] != spotter) { i++; }
+        if (!latest) {
+            if (i < record.spotterCount || record.spotterCount == SpotRecord::maxSpotters) { return false; }
+            record.spotters[record.spotterCount++] = spotter;
+            return true;
+        }
+        if (i == 0 && record.spotterCount > 0) { return false; }
+        if (i == record.spotterCount) {
+            // new, the oldest falls off if we're full
+            if (record.spotterCount < SpotRecord::maxSpotters) { record.spotterCount++; }
+            i = record.spotterCount - 1;
+        }
+        for (; i > 0; i--) { record.spotters[i] = record.spotters[i - 1]; }
+        record.spotters[0] = spotter;
+        return true;
+    }
+
+    // hint is where we expect the spot to go in the frequency index, and
+    // is left just past wherever it went. slot is where it is now
+    bool upsert(const SpotRecord& spot, FreqIndex::const_iterator& hint, uint32_t* slotOut) {
+        uint32_t bit = 1u << addSource(spot.source);
+        SpotKey spotKey = key(spot.label, spot.frequency);
+        auto existing = keyIndex.find(spotKey);
+        if (existing == keyIndex.end()) {
+            uint32_t slot = allocSlot(spot);
+            SpotRecord& stored = slots[slot];
+            stored.sources = bit;
+            stored.spotterCount = 1;
+            keyIndex.emplace(spotKey, slot);
+            hint = std::next(freqIndex.emplace_hint(hint, spot.frequency, slot));
+            expiryHeap.push({spot.spotTime, slot, generations[slot]});
+            *slotOut = slot;
+            return true;
+        }
+
+        uint32_t slot = existing->second;
+        *slotOut = slot;
+        SpotRecord& stored = slots[slot];
+        // another source with the same time isn't newer either, or two
+        // sources carrying the same spot would take turns replacing it
+        if (stored.spotTime > spot.spotTime || (stored.spotTime == spot.spotTime && stored.source != spot.source)) {
+            // but it does tell us who else heard it
+            bool changed = !(stored.sources & bit);
+            stored.sources |= bit;
+            changed |= addSpotter(stored, spot.spotter(), false);
+            return changed;
+        }
+        if (sameSpot(stored, spot)) {
+            // providers re-send spots we already have all the time
+            return false;
+        }
+
+        // re-key on frequency in case the station moved
+        // so iteration always stays in frequency order
+        if (stored.frequency != spot.frequency) {
+            FreqKey oldKey(stored.frequency, slot);
+            if (hint != freqIndex.end() && *hint == oldKey) {
+                ++hint;
+            }
+            freqIndex.erase(oldKey);
+            hint = std::next(freqIndex.emplace_hint(hint, spot.frequency, slot));
+        }
+        if (stored.spotTime != spot.spotTime) {
+            expiryHeap.push({spot.spotTime, slot, generations[slot]});
+        }
+        SpotRecord previous = stored;
+        stored = spot;
+        stored.sources = previous.sources | bit;
+        std::copy(previous.spotters, previous.spotters + previous.spotterCount, stored.spotters);
+        stored.spotterCount = previous.spotterCount;
+        addSpotter(stored, spot.spotter(), true);
+        return true;
+    }
+
+    uint32_t allocSlot(const SpotRecord& spot) {
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            slots[slot] = spot;
+            live[slot] = true;
+            generations[slot]++;
+            return slot;
+        }
+        slots.push_back(spot);
+        live.push_back(true);
+        generations.push_back(0);
+        return slots.size() - 1;
+    }
+
+    void freeSlot(uint32_t slot) {
+        live[slot] = false;
+        freeSlots.push_back(slot);
+    }
+
+    // re-intern what live spots use into a fresh pool
+    // snapshots still on the old pool keep it alive until they're done
+    void compactStrings() {
+        auto fresh = std::make_shared<StringPool>();
+        std::vector<uint32_t> remap(strings->size(), UINT32_MAX);
+        auto move = [&](uint32_t& id) {
+            if (remap[id] == UINT32_MAX) {
+                remap[id] = fresh->intern(strings->get(id));
+            }
+            id = remap[id];
+        };
+        keyIndex.clear();
+        for (uint32_t slot = 0; slot < slots.size(); slot++) {
+            if (!live[slot]) { continue; }
+            SpotRecord& r = slots[slot];
+            move(r.label);
+            move(r.comment);
+            move(r.location);
+            for (size_t i = 0; i < r.spotterCount; i++) {
+                move(r.spotters[i]);
+            }
+            keyIndex.emplace(key(r.label, r.frequency), slot);
+        }
+        strings = std::move(fresh);
+    }
+
+    typedef std::priority_queue<ExpiryKey, std::vector<ExpiryKey>, std::greater<ExpiryKey>> ExpiryHeap;
+
+    std::shared_ptr<StringPool> strings;
+    std::vector<SpotRecord> slots;
+    std::vector<bool> live;
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<SpotKey, uint32_t> keyIndex; // label and band to slot
+    FreqIndex freqIndex;
+    ExpiryHeap expiryHeap;
+
+    // by store id
+    std::vector<SpotSource*> sources;
+    SpotSource* lastSource = NULL;
+    uint32_t lastSourceId = 0;
+
+    uint64_t version = 0;
+    std::shared_ptr<const SpotSnapshot> published;
+};
+
+#endif //__SDRPP_SPOTS_SPOT_STORE_H
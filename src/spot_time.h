@@ -0,0 +1,184 @@
+#ifndef __SDRPP_SPOTS_SPOT_TIME_H
+#define __SDRPP_SPOTS_SPOT_TIME_H
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include "main.h"
+
+// decoding of the timestamps the providers send, all UTC
+// plain arithmetic, no libc time calls, so no timezone lock and safe
+// from any thread
+
+typedef std::chrono::time_point<std::chrono::system_clock> SpotTime;
+
+// where "now" comes from for spot expiry, display and resolving bare
+// times of day. the system clock unless something like a replay swaps in
+// its own, which it should do before anything starts
+struct SpotClock {
+    typedef SpotTime (*Now)(void* ctx);
+
+    static SpotTime now() {
+        return nowFunc ? nowFunc(nowCtx) : std::chrono::system_clock::now();
+    }
+
+    // NULL goes back to the system clock
+    static void set(Now now, void* ctx) {
+        nowFunc = now;
+        nowCtx = ctx;
+    }
+
+    static inline Now nowFunc = NULL;
+    static inline void* nowCtx = NULL;
+};
+
+// days since 1970-01-01 for a proleptic Gregorian date
+// from Howard Hinnant's date algorithms
+constexpr int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);                // [0, 399]
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1; // [0, 365]
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;     // [0, 146096]
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static_assert(daysFromCivil(1970, 1, 1) == 0, "epoch");
+static_assert(daysFromCivil(2000, 3, 1) == 11017, "leap century");
+static_assert(daysFromCivil(2024, 2, 29) == 19782, "leap day");
+
+constexpr bool isLeapYear(int y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+constexpr int daysInMonth(int y, int m) {
+    return m == 2 ? (isLeapYear(y) ? 29 : 28) : (m == 4 || m == 6 || m == 9 || m == 11) ? 30 : 31;
+}
+
+// validates the fields and converts to a time point
+inline bool civilTime(int y, int M, int d, int h, int m, int s, SpotTime* t) {
+    if (y < 1970 || M < 1 || M > 12 || d < 1 || d > daysInMonth(y, M)) { return false; }
+    if (h < 0 || h > 23 || m < 0 || m > 59 || s < 0 || s > 60) { return false; }
+    int64_t seconds = daysFromCivil(y, M, d) * 86400 + h * 3600 + m * 60 + s;
+    *t = SpotTime(std::chrono::seconds(seconds));
+    return true;
+}
+
+// exactly n digits at the front of s, consumed
+inline bool takeDigits(std::string_view& s, size_t n, int* value) {
+    if (s.size() < n) { return false; }
+    int v = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') { return false; }
+        v = v * 10 + (s[i] - '0');
+    }
+    *value = v;
+    s.remove_prefix(n);
+    return true;
+}
+
+inline bool takeChar(std::string_view& s, char c) {
+    if (s.empty() || s[0] != c) { return false; }
+    s.remove_prefix(1);
+    return true;
+}
+
+// ISO-8601, like POTA and SOTA send
+// YYYY-MM-DDTHH:MM[:SS[.fff]] with an optional Z or +HH:MM/-HH:MM,
+// no offset means UTC. fractions of a second are dropped
+inline bool parseIsoTime(std::string_view s, SpotTime* t) {
+    int y, M, d, h, m, sec = 0;
+    if (!takeDigits(s, 4, &y) || !takeChar(s, '-') || !takeDigits(s, 2, &M) || !takeChar(s, '-') || !takeDigits(s, 2, &d)) {
+        return false;
+    }
+    if (!takeChar(s, 'T') && !takeChar(s, ' ')) { return false; }
+    if (!takeDigits(s, 2, &h) || !takeChar(s, ':') || !takeDigits(s, 2, &m)) { return false; }
+    if (takeChar(s, ':')) {
+        if (!takeDigits(s, 2, &sec)) { return false; }
+        if (takeChar(s, '.')) {
+            while (!s.empty() && s[0] >= '0' && s[0] <= '9') { s.remove_prefix(1); }
+        }
+    }
+
+    int offset = 0;
+    if (!s.empty() && (s[0] == '+' || s[0] == '-')) {
+        int sign = s[0] == '-' ? -1 : 1;
+        s.remove_prefix(1);
+        int oh, om = 0;
+        if (!takeDigits(s, 2, &oh)) { return false; }
+        takeChar(s, ':');
+        if (!s.empty() && !takeDigits(s, 2, &om)) { return false; }
+        offset = sign * (oh * 3600 + om * 60);
+    } else {
+        takeChar(s, 'Z');
+    }
+    if (!s.empty()) { return false; }
+
+    if (!civilTime(y, M, d, h, m, sec, t)) { return false; }
+    *t -= std::chrono::seconds(offset);
+    return true;
+}
+
+// HHMM YYYY-MM-DD, like HamQTH sends
+// returns 0 on success or a code saying what was wrong
+inline int parseTime(std::string_view s, SpotTime* t) {
+    // HHMM YYYY-mm-dd
+    std::string_view parts[3];
+    size_t loc = s.find(" ");
+    if(loc == s.npos || loc+1 >= s.size()) {
+        return 1;
+    }
+    int time;
+    if(!parseInt(s.substr(0, loc), &time)) {
+        return 2;
+    }
+    if(time % 100 >= 60) {
+        return 3;
+    }
+    if(time / 100 >= 24) {
+        return 4;
+    }
+
+    if(splitFields(s.substr(loc+1), '-', parts, 3) != 3) {
+        return 5;
+    }
+    int year;
+    if(!parseInt(parts[0], &year)) {
+        return 6;
+    }
+    int month;
+    if(!parseInt(parts[1], &month)) {
+        return 7;
+    }
+    if(month < 1 || month > 12) {
+        return 8;
+    }
+    int day;
+    if(!parseInt(parts[2], &day) || !civilTime(year, month, day, time / 100, time % 100, 0, t)) {
+        return 9;
+    }
+    return 0;
+}
+
+// WWFF sends the date and time as integers, YYYYMMDD and HHMM
+inline bool wwffTime(int date, int time, SpotTime* t) {
+    return civilTime(date / 10000, date / 100 % 100, date % 100, time / 100, time % 100, 0, t);
+}
+
+// a bare HHMM time of day, like DX cluster spots have, taken to be the
+// most recent such time as of now (allowing for a little clock skew)
+inline bool recentTime(int hhmm, SpotTime now, SpotTime* t) {
+    int h = hhmm / 100;
+    int m = hhmm % 100;
+    if (hhmm < 0 || h > 23 || m > 59) { return false; }
+    int64_t nowSeconds = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    int64_t seconds = nowSeconds - nowSeconds % 86400 + h * 3600 + m * 60;
+    if (seconds > nowSeconds + 300) {
+        // yesterday
+        seconds -= 86400;
+    }
+    *t = SpotTime(std::chrono::seconds(seconds));
+    return true;
+}
+
+#endif //__SDRPP_SPOTS_SPOT_TIME_H
@@ -0,0 +1,189 @@
+#ifndef __SDRPP_SPOTS_STRING_POOL_H
+#define __SDRPP_SPOTS_STRING_POOL_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**********************************************
+ * Append-only arena of interned strings, each identified by a 32 bit id.
+ * Callsigns, park names, summit descriptions and so on repeat across
+ * thousands of spots, this keeps one copy of each.
+ *
+ * One writer calls intern(). Any number of readers may call get() at
+ * the same time, for ids they got (through a snapshot, say) after the
+ * writer interned them: string bytes and the id table live in fixed
+ * blocks that never move once written.
+ * Nothing is ever removed, drop the whole pool to reclaim space.
+ **********************************************/
+class StringPool {
+public:
+    StringPool() {
+        // id 0 is always the empty string
+        intern(std::string_view());
+    }
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // writer only
+    uint32_t intern(std::string_view s) {
+        buildIndex();
+        auto existing = index.find(s);
+        if (existing != index.end()) {
+            return existing->second;
+        }
+
+        uint32_t id = count;
+        size_t page = id / pageSize;
+        if (page >= maxPages) {
+            // out of ids, everything new is empty. not reachable with
+            // the store compacting its pool
+            return 0;
+        }
+        if (!pages[page]) {
+            pages[page] = std::make_unique<Entry[]>(pageSize);
+        }
+
+        const char* data = store(s);
+        pages[page][id % pageSize] = {data, (uint32_t)s.size()};
+        count++;
+        indexed = count;
+        index.emplace(std::string_view(data, s.size()), id);
+        return id;
+    }
+
+    // writer only, the id of s if it's been interned
+    bool find(std::string_view s, uint32_t* id) {
+        buildIndex();
+        auto existing = index.find(s);
+        if (existing == index.end()) { return false; }
+        *id = existing->second;
+        return true;
+    }
+
+    // safe alongside the writer, see above
+    std::string_view get(uint32_t id) const {
+        const Entry& e = pages[id / pageSize][id % pageSize];
+        return std::string_view(e.data, e.len);
+    }
+
+    // writer only, room for n more strings without rehashing
+    void reserve(size_t n) {
+        index.reserve(count + n);
+    }
+
+    // writer only, on a pool with nothing but the empty string in it:
+    // take count strings laid out back to back in data at once, the i-th
+    // ending at ends[i]. the first must be the empty string, ids are the
+    // strings' positions. much cheaper than interning them one by one,
+    // the index isn't built until the next intern() or find()
+    // returns false, taking nothing, if the pool isn't empty or the
+    // strings don't fit
+    bool load(const char* data, const std::vector<uint32_t>& ends) {
+        uint32_t loaded = ends.size();
+        if (count != 1 || loaded < 1 || ends[0] != 0 || loaded > pageSize * maxPages) { return false; }
+        size_t total = ends.back();
+        char* bytes = NULL;
+        if (total > 0) {
+            blocks.push_back(std::make_unique<char[]>(total));
+            reserved += total;
+            bytes = blocks.back().get();
+            memcpy(bytes, data, total);
+            stored += total;
+        }
+        for (uint32_t id = 1; id < loaded; id++) {
+            size_t page = id / pageSize;
+            if (!pages[page]) {
+                pages[page] = std::make_unique<Entry[]>(pageSize);
+            }
+            pages[page][id % pageSize] = {bytes + ends[id - 1], ends[id] - ends[id - 1]};
+        }
+        count = loaded;
+        return true;
+    }
+
+    // number of strings, including the empty one
+    size_t size() const { return count; }
+
+    // bytes of string data held
+    size_t bytes() const { return stored; }
+
+    // heap bytes held, for benchmarks: the id pages, the blocks the
+    // strings are in and the index, which is estimated from its node and
+    // bucket counts
+    size_t pageBytes() const {
+        size_t allocated = 0;
+        for (size_t page = 0; page < maxPages && pages[page]; page++) { allocated++; }
+        return sizeof(pages) + allocated * pageSize * sizeof(Entry);
+    }
+    size_t blockBytes() const { return reserved + blocks.capacity() * sizeof(blocks[0]); }
+    size_t indexBytes() const {
+        // a node is the next pointer, the entry and its cached hash
+        size_t node = sizeof(void*) + sizeof(decltype(index)::value_type) + sizeof(size_t);
+        return index.size() * node + index.bucket_count() * sizeof(void*);
+    }
+
+private:
+    struct Entry {
+        const char* data;
+        uint32_t len;
+    };
+
+    static constexpr size_t blockSize = 64 * 1024;
+    static constexpr size_t pageSize = 4096;   // ids per page
+    static constexpr size_t maxPages = 4096;   // so 16M ids
+
+    const char* store(std::string_view s) {
+        if (s.empty()) {
+            return "";
+        }
+        if (s.size() > blockSize / 4) {
+            // big ones get a block to themselves
+            blocks.push_back(std::make_unique<char[]>(s.size()));
+            reserved += s.size();
+            memcpy(blocks.back().get(), s.data(), s.size());
+            stored += s.size();
+            return blocks.back().get();
+        }
+        if (s.size() > remaining) {
+            blocks.push_back(std::make_unique<char[]>(blockSize));
+            reserved += blockSize;
+            cursor = blocks.back().get();
+            remaining = blockSize;
+        }
+        char* data = cursor;
+        memcpy(data, s.data(), s.size());
+        cursor += s.size();
+        remaining -= s.size();
+        stored += s.size();
+        return data;
+    }
+
+    // index the strings load() took
+    void buildIndex() {
+        if (indexed == count) { return; }
+        index.reserve(count);
+        for (uint32_t id = indexed; id < count; id++) {
+            index.emplace(get(id), id);
+        }
+        indexed = count;
+    }
+
+    std::unique_ptr<Entry[]> pages[maxPages];
+    uint32_t count = 0;
+
+    // only the writer touches these
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor = NULL;
+    size_t remaining = 0;
+    size_t stored = 0;
+    size_t reserved = 0; // all the blocks, stored or not
+    std::unordered_map<std::string_view, uint32_t> index;
+    uint32_t indexed = 0; // ids below this are in index
+};
+
+#endif //__SDRPP_SPOTS_STRING_POOL_H